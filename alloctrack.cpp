@@ -0,0 +1,79 @@
+#include "alloctrack.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static const char* const AllocPhaseNames[ALLOC_PHASE_CNT] = {
+    "idle", "search", "warmup", "tree", "output"
+};
+
+std::ostream& print_alloc_stats(const AllocStats& stats, std::ostream& os) {
+    os << "info string alloc";
+    for ( int phase = AllocSearch; phase < ALLOC_PHASE_CNT; phase++ )
+        os << " " << AllocPhaseNames[phase] << " " << stats.allocs[phase] << "/" << stats.bytes[phase] << "B"
+           << " free " << stats.frees[phase];
+    os << std::endl;
+    return os;
+}
+
+#ifdef TRACK_ALLOCATIONS
+
+/*-- The hooks only touch the trivial thread locals above and report with stdio, so they never allocate themselves --*/
+
+static void* tracked_alloc(std::size_t size, std::size_t alignment = 0) {
+    const AllocPhase phase = alloc_phase();
+    AllocStats& stats = alloc_stats();
+    stats.allocs[phase]++;
+    stats.bytes[phase] += size;
+
+    if ( phase == AllocTree ) {
+        std::fprintf(stderr, "error: %zu bytes allocated inside alphabeta/qsearch\n", size);
+        std::abort();
+    }
+
+    size = size ? size : 1;
+#ifdef _WIN32
+    void* ptr = alignment ? _aligned_malloc(size, alignment) : std::malloc(size);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    void* ptr = alignment ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment) : std::malloc(size);
+#endif
+    if ( !ptr )
+        throw std::bad_alloc();
+    return ptr;
+}
+
+static void tracked_free(void* ptr, bool aligned = false) {
+    if ( !ptr )
+        return;
+    alloc_stats().frees[alloc_phase()]++;
+#ifdef _WIN32
+    if ( aligned ) {
+        _aligned_free(ptr);
+        return;
+    }
+#endif
+    (void)aligned;
+    std::free(ptr);
+}
+
+void* operator new(std::size_t size) { return tracked_alloc(size); }
+void* operator new[](std::size_t size) { return tracked_alloc(size); }
+void operator delete(void* ptr) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr) noexcept { tracked_free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { tracked_free(ptr); }
+
+void* operator new(std::size_t size, std::align_val_t al) { return tracked_alloc(size, std::size_t(al)); }
+void* operator new[](std::size_t size, std::align_val_t al) { return tracked_alloc(size, std::size_t(al)); }
+void operator delete(void* ptr, std::align_val_t) noexcept { tracked_free(ptr, true); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { tracked_free(ptr, true); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { tracked_free(ptr, true); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { tracked_free(ptr, true); }
+
+#endif // TRACK_ALLOCATIONS
@@ -0,0 +1,72 @@
+#ifndef ALLOCTRACK_H
+#define ALLOCTRACK_H
+
+#include <cstdint>
+#include <iostream>
+
+#include "types.h"
+
+/*-----------------------------
+ -- Allocation tracking --
+ ----------------------------*/
+
+/* --
+-- With TRACK_ALLOCATIONS (types.h) the global operator new/delete are replaced by counting ones which
+-- attribute every allocation to the phase of the search the thread is in. The search tree must not
+-- allocate: once the first iteration has warmed up the per thread tables, an allocation inside
+-- alphabeta/qsearch prints its size and aborts. Without the define ALLOC_PHASE is empty.
+-- */
+enum AllocPhase {
+    AllocIdle,          // outside of the search, not reported
+    AllocSearch,        // setup and bookkeeping of the iterations
+    AllocWarmup,        // tree of the first iteration
+    AllocTree,          // tree of the following iterations, allocations abort
+    AllocOutput,        // info output
+    ALLOC_PHASE_CNT
+};
+
+struct AllocStats {
+    std::uint64_t allocs[ALLOC_PHASE_CNT];
+    std::uint64_t bytes[ALLOC_PHASE_CNT];
+    std::uint64_t frees[ALLOC_PHASE_CNT];
+
+    inline void clear() { *this = AllocStats(); }
+};
+
+/*-- Allocation counters of the calling thread --*/
+inline AllocStats& alloc_stats() {
+    thread_local AllocStats stats = {};
+    return stats;
+}
+
+/*-- Phase of the calling thread --*/
+inline AllocPhase& alloc_phase() {
+    thread_local AllocPhase phase = AllocIdle;
+    return phase;
+}
+
+/*-- Sets the phase of the thread for the lifetime of the scope --*/
+class AllocPhaseScope {
+    AllocPhase previous;
+
+public:
+    inline explicit AllocPhaseScope(AllocPhase phase) : previous(alloc_phase()) { alloc_phase() = phase; }
+    inline ~AllocPhaseScope() { alloc_phase() = previous; }
+
+    AllocPhaseScope(const AllocPhaseScope&) = delete;
+    AllocPhaseScope& operator=(const AllocPhaseScope&) = delete;
+};
+
+#define ALLOC_PHASE_NAME2(line) allocPhase_##line
+#define ALLOC_PHASE_NAME(line) ALLOC_PHASE_NAME2(line)
+
+#ifdef TRACK_ALLOCATIONS
+#define ALLOC_PHASE(phase) AllocPhaseScope ALLOC_PHASE_NAME(__LINE__)(phase)
+#else
+#define ALLOC_PHASE(phase)
+#endif
+
+/*-- Prints the allocations and frees of every reported phase as an info string --*/
+std::ostream& print_alloc_stats(const AllocStats& stats, std::ostream& os = std::cout);
+
+#endif // ALLOCTRACK_H
@@ -0,0 +1,23 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstdint>
+
+/*---------------
+ -- Benchmark --
+ --------------*/
+
+/* --
+-- Searches a fixed set of positions to a fixed depth and prints the total nodes, elapsed time and nodes per second.
+-- Every position starts with empty tables, so the node count is a deterministic signature of the search
+-- which doesn't depend on the order or on the thread the positions are searched on. The search itself
+-- runs on one thread, more threads search several positions at once with a table of hashMb each.
+-- Returns the total nodes.
+-- */
+std::uint64_t bench(std::uint64_t hashMb, int threads, int depth);
+
+/*-- The positions searched by bench, they are the corpus of the micro-benchmarks as well --*/
+extern const char* const BenchPositions[];
+extern const int BENCH_POSITION_CNT;
+
+#endif // BENCH_H
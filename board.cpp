@@ -1,8 +1,6 @@
 #include "board.h"
 #include "search.h"
-#include <iterator>
 #include <iostream>
-#include <sstream> // for FEN 
 #include <limits> // INT_MAX, INT_MIN
 #include <algorithm> //std::min, std::max
 
@@ -13,213 +11,155 @@ Board::Board()
     table = std::make_shared<TT>(256);
 }
 
+Board::Board(std::uint64_t ttSizeMb)
+{
+    table = std::make_shared<TT>(ttSizeMb);
+}
+
 Board::~Board() {
     //free(table);
 }
 
 void Board::moveDo(Move move)
 {
+    if (side == White)
+        moveDo<White>(move);
+    else
+        moveDo<Black>(move);
+}
 
-    const MoveType moveType = move.type();
-    const Square origin     = move.origin();
-    const Square target     = move.target();
-    Piece piece = pieceAt(origin);
-    PieceType pieceType = piece.type();
-
-    assert(piece.type() != Empty);
-
-    /* handle state changes */
-
+template <PieceColor Color>
+void Board::moveDo(Move move)
+{
     // save the previous state of the position
     state_stack.emplace_back(positionState());
 
-    // Remove en passant square from the hash
-    // Note that state here referes still to the old state before the move
-    if (state.epSquare != NOT_ENPASSANT_SQ )
-        state.hash ^= Zobrist::enpassant[state.epSquare.file()];
+    // store the captured piece, en passant always captures a pawn and restores it without the stack
+    if (move.isCapture() && move.type() != CaptureEnPas)
+        captured_pieses.emplace_back(pieceAt(move.target()));
 
-    // set en passant square
-    if (moveType == DoublePush) {
-        state.epSquare = piece.color() == White
-                ? target.prevRank()
-                : target.nextRank();
+    apply<Color>(move);
 
-        // Hash the enpassant move
-        state.hash ^= Zobrist::enpassant[state.epSquare.file()];
+    if (nnue::active())
+        nnue::accumulators().push(*this);
 
-    } else {
-        state.epSquare = NOT_ENPASSANT_SQ;
-    }
+    moves_done.emplace_back(move);
+}
 
-    // handle half move clock for the fifty-move rule
-    if (moveType == Capture || piece.isPawn()) {
-        state.halfmove_clock = 0;
-    } else {
-        ++state.halfmove_clock;
-    }
+void Board::moveDoCopy(Move move)
+{
+    // only the state is saved, the caller restores the position from its own copy
+    state_stack.emplace_back(positionState());
+    apply(move);
 
-    // handle castling rights
-    const Bitboard originBB   = SHL(1,origin);
-    constexpr Bitboard castleOriginSquares = SHL(1,e1) | SHL(1,e8)
-            | SHL(1,a1) | SHL(1,h1) | SHL(1,a8) | SHL(1,h8);
-
-    if (castleOriginSquares & originBB) {
-        if (origin == e1 ) { // white king moves
-            state.castle_rights &= ~(CastlingFlagWK | CastlingFlagWQ);
-        } else if (origin == e8) { // black king moves
-            state.castle_rights &= ~(CastlingFlagBK | CastlingFlagBQ);
-        } else if (origin == a1) { // wq rook moves
-            state.castle_rights &= ~(CastlingFlagWQ);
-        } else if (origin == h1) { // wk rook moves
-            state.castle_rights &= ~(CastlingFlagWK);
-        } else if (origin == a8) { // bq rook moves
-            state.castle_rights &= ~(CastlingFlagBQ);
-        } else if (origin == h8) { // bk rook moves
-            state.castle_rights &= ~(CastlingFlagBK);
-        }
-
-        // Hash the change in castling rights
-        state.hash ^= Zobrist::castling[state_stack.back().castle_rights]; // remove old castling flags
-        state.hash ^= Zobrist::castling[state.castle_rights];              // set new castling flags
-    }
+    if (nnue::active())
+        nnue::accumulators().push(*this);
+}
 
-    /* make positional changes */
-    if (moveType == QuietMove) {
-        removePiece(origin );
-        setPiece(piece, target);
+void Board::moveUndoCopy(const Position& parent)
+{
+    static_cast<Position&>(*this) = parent;
+    state_stack.pop_back();
 
-    } else if (moveType == Capture) {
-        captured_pieses.emplace_back(pieceAt(target)); // store captured piece
-        removePiece(origin);
-        removePiece(target);
-        setPiece(piece, target);
-
-    } else if (moveType == DoublePush) {
-        removePiece(origin);
-        setPiece(piece, target);
-
-    } else if (move.isPromotion() ) {
-        if (move.isCapture() ) {
-            captured_pieses.emplace_back(pieceAt(target)); // store captured piece
-            removePiece(target);
-        }
-        removePiece(origin);
-        piece.setType(move.promoteTo() );
-        setPiece(piece, target);
-
-    } else if (move.isCastle()) {
-        if (move.type() == CastleQSide) {
-            const Square rookQSide   = piece.color() == White ? Square(a1) : Square(a8);
-            const Square rookQTarget = piece.color() == White ? Square(d1) : Square(d8);
-            setPiece(pieceAt(rookQSide), rookQTarget);
-            removePiece(rookQSide);
-            removePiece(origin );
-            setPiece(piece, target );
-        } else {
-            const Square rookKSide   = piece.color() == White ? Square(h1) : Square(h8);
-            const Square rookKTarget = piece.color() == White ? Square(f1) : Square(f8);
-            setPiece(pieceAt(rookKSide), rookKTarget);
-            removePiece(rookKSide);
-            removePiece(origin );
-            setPiece(piece, target );
-        }
-
-    } else if (moveType == CaptureEnPas) {
-        // target points to the en passant square
-        Square capturedPawn = piece.color() == White
-                ? target.prevRank()
-                : target.nextRank();
-
-        if ( pieceAt(capturedPawn).type() != Pawn ) {
-            //Piece pieceat = pieceAt(capturedPawn);
-            //cout << (int)piece.type() << " ";
-            print_board_with_files(*this);
-            
-        }
-
-        assert(pieceAt(capturedPawn).type() == Pawn);
-        assert(pieceAt(origin).type() == Pawn);
-
-        captured_pieses.emplace_back(pieceAt(capturedPawn) ); // store captured pawn
-        removePiece(capturedPawn);
-        removePiece(origin );
-        setPiece(piece, target );
-    }
-    else {
-        assert(false); // invalid move in moveDo
-    }
+    if (nnue::active())
+        nnue::accumulators().pop();
+}
 
-    moves_done.emplace_back(move);
-    side = !side;
-    state.hash ^= Zobrist::black_to_move;
+void Board::moveUndo()
+{
+    // the side that made the move is the opposite of the side to move
+    if (side == White)
+        moveUndo<Black>();
+    else
+        moveUndo<White>();
 }
 
+template <PieceColor Color>
 void Board::moveUndo()
 {
+    constexpr PieceColor Ally  = Color == White ? White : Black;
+    constexpr PieceColor Enemy = Color == White ? Black : White;
+
+    constexpr Square RookQSide   = Color == White ? Square(a1) : Square(a8);
+    constexpr Square RookQTarget = Color == White ? Square(d1) : Square(d8);
+    constexpr Square RookKSide   = Color == White ? Square(h1) : Square(h8);
+    constexpr Square RookKTarget = Color == White ? Square(f1) : Square(f8);
+
     const Move move = moves_done.back();
     
     const Square origin = move.origin();
     const Square target = move.target();
-    
-    const Piece pieceOrig = pieceAt(target);
-    const MoveType moveType = move.type();
 
-    assert(pieceOrig.type() != Empty);
+    assert(side == Enemy);
+    assert(pieceAt(target).color() == Ally && pieceAt(target).type() != Empty);
 
-    if (moveType == QuietMove) {
-        removePiece(target );
-        setPiece(pieceOrig, origin );
-    } else if (moveType == Capture) {
-        removePiece(target );
-        setPiece(captured_pieses.back(), target );
+    switch (move.type()) {
+    case QuietMove:
+    case DoublePush:
+        movePiece(target, origin);
+        break;
+
+    case Capture:
+        movePiece(target, origin);
+        setPiece(captured_pieses.back(), target);
         captured_pieses.pop_back();
-        setPiece(pieceOrig, origin );
+        break;
+
+    case CastleKSide:
+        movePiece(RookKTarget, RookKSide);
+        movePiece(target, origin);
+        break;
 
-    } else if (moveType == DoublePush) {
-        removePiece(target );
-        setPiece(pieceOrig, origin );
-    } else if (move.isPromotion() ) {
+    case CastleQSide:
+        movePiece(RookQTarget, RookQSide);
+        movePiece(target, origin);
+        break;
+
+    case CaptureEnPas:
+        movePiece(target, origin);
+        setPiece(Enemy, Pawn, Color == White ? target.prevRank() : target.nextRank());
+        break;
+
+    case PromToKnightCapture: case PromToBishopCapture:
+    case PromToRookCapture:   case PromToQueenCapture:
         removePiece(target);
-        if (move.isCapture() ) {
-            setPiece(captured_pieses.back(), target );
-            captured_pieses.pop_back();
-        }
-        setPiece(pieceOrig.color(), Pawn, origin);
-    } else if (move.isCastle()) {
-        if (move.type() == CastleQSide) {
-            const Square rookQSide   = pieceOrig.color() == White ? Square(a1) : Square(a8);
-            const Square rookQTarget = pieceOrig.color() == White ? Square(d1) : Square(d8);
-            removePiece(rookQTarget);
-            setPiece(pieceOrig.color(), Rook, rookQSide);
-            removePiece(target );
-            setPiece(pieceOrig, origin );
-        } else {
-            const Square rookKSide   = pieceOrig.color() == White ? Square(h1) : Square(h8);
-            const Square rookKTarget = pieceOrig.color() == White ? Square(f1) : Square(f8);
-            removePiece(rookKTarget);
-            setPiece(pieceOrig.color(), Rook, rookKSide);
-            removePiece(target );
-            setPiece(pieceOrig, origin );
-        }
-    } else if (moveType == CaptureEnPas) {
-        Square capturedPawn = pieceOrig.color() == White
-                ? target.prevRank()
-                : target.nextRank();
-        setPiece(captured_pieses.back(), capturedPawn);
+        setPiece(captured_pieses.back(), target);
         captured_pieses.pop_back();
-        removePiece(target );
-        setPiece(pieceOrig, origin );
-    } else {
+        setPiece(Ally, Pawn, origin);
+        break;
+
+    case PromToKnight: case PromToBishop:
+    case PromToRook:   case PromToQueen:
+        removePiece(target);
+        setPiece(Ally, Pawn, origin);
+        break;
+
+    default:
         assert(false); // invalid move in moveUndo
     }
 
     moves_done.pop_back();
-    side = !side;
+    side = Ally;
 
     // restore state
     setPositionState(state_stack.back());
     state_stack.pop_back();
 
+    if (nnue::active())
+        nnue::accumulators().pop();
+}
+
+template void Board::moveDo<White>(Move move);
+template void Board::moveDo<Black>(Move move);
+template void Board::moveUndo<White>();
+template void Board::moveUndo<Black>();
+
+void Board::reserveStack(std::size_t plies) {
+    moves_done.reserve(moves_done.size() + plies);
+    state_stack.reserve(state_stack.size() + plies);
+    captured_pieses.reserve(captured_pieses.size() + plies);
+    if (nnue::active())
+        nnue::accumulators().reserve(plies);
 }
 
 void Board::moveDoNull() {
@@ -271,198 +211,83 @@ Key Board::hashPosition(const Position &pos) {
 }
 
 
-Board Board::fromFEN(std::string fenRecord)
+Board Board::fromFEN(std::string_view fenRecord)
 {
-    using namespace std;
     Board board;
+    const FenResult result = board.setFromFEN(fenRecord);
+    assert(result && "fromFEN is for known records, setFromFEN reports the errors of the others");
+    (void)result;
+    return board;
+}
 
-    /* split fenRecord */
-    istringstream iss(fenRecord);
-    vector<string> records;
-    copy(istream_iterator<string>(iss), istream_iterator<string>(), back_inserter(records));
-
-    int rank = 7;
-    int file = 0;
-    /* find positions of the pieces */
-    for (char& ch : records[0]) {
-        if (ch == '/') {
-            rank -= 1;
-            file = 0;
-        } else  if (std::isdigit(ch)) {
-            int digit = ch - '0';
-            file += digit;
-        } else {
-            Piece piece;
-
-            char name = std::toupper(ch);
-            if (name == 'P') {
-                piece = Piece(std::isupper(ch) ? White : Black, Pawn);
-            } else if (name == 'N') {
-                piece = Piece(std::isupper(ch) ? White : Black, Knight);
-            } else if (name == 'B') {
-                piece = Piece(std::isupper(ch) ? White : Black, Bishop);
-            } else if (name == 'R') {
-                piece = Piece(std::isupper(ch) ? White : Black, Rook);
-            } else if (name == 'Q') {
-                piece = Piece(std::isupper(ch) ? White : Black, Queen);
-            } else if (name == 'K') {
-                piece = Piece(std::isupper(ch) ? White : Black, King);
-            }
-
-            board.setPiece(piece, Square(file, rank));
-            ++file;
-        }
-    }
-
-    /* get active color */
-    if (records.size() > 1)
-        board.setSideToMove(records[1] == "b" ? Black : White);
-
-    /* get castling rights */
-    if (records.size() > 2) {
-        std::uint8_t castling = NoCastlingFlags;
-        for (char& ch: records[2]) {
-            if (ch == 'K')
-                castling |= CastlingFlagWK;
-            else if (ch == 'Q')
-                castling |= CastlingFlagWQ;
-            else if (ch == 'k')
-                castling |= CastlingFlagBK;
-            else if (ch == 'q')
-                castling |= CastlingFlagBQ;
-        }
-        board.state.castle_rights = CastlingRights(castling);
-    }
-
-    /* get en passant square */
-    if (records.size() > 3) {
-        Square enPassant = NOT_ENPASSANT;
-        if (records[3].size() == 2) {
-            int file = records[3][0] - 'a';
-            int rank = records[3][1] - '1';
-            enPassant = Square(file, rank);
-        }
-        board.state.epSquare = enPassant;
-    }
+FenResult Board::setFromFEN(std::string_view fenRecord)
+{
+    Position pos;
+    const FenResult result = pos.parseFEN(fenRecord);
+    if (!result)
+        return result;
 
-    /* get halfmove clock */
-    if (records.size() > 4) {
-        board.state.halfmove_clock = atoi(records[4].c_str());
-    }
+    static_cast<Position&>(*this) = pos;
+    moves_done.clear();
+    state_stack.clear();
+    captured_pieses.clear();
 
-    board.state.hash = hashPosition(board);
+    // the moves made to set up positions would pile up on the stack of this thread
+    nnue::accumulators().clear();
 
-    return board;
+    return result;
 }
 
 std::string Board::toFEN() const {
-    
-    const Position& pos = *this;
-
-    int rank = 7;
-    //int file = 0;
-
-    std::string res;
-
-    while (rank >= 0) {
-        int fileOnRank = 0;
-        int empty = 0;
-
-        // Print pieces
-        while (fileOnRank < 8) {
-            Piece piece = pos.pieceAt(Square(fileOnRank, rank));
-
-            // Count only empty squares and print the total number
-            if (piece.isEmpty() && fileOnRank == 7) {
-               res += std::to_string(empty+1);
-               empty = 0;
-            } else if ( piece.isEmpty() ) {
-                empty++;
-            } else if ( !piece.isEmpty() && empty ) {
-                res += std::to_string(empty);
-                empty = 0;
-            }
-
-            if ( piece.isPawn() ) {
-                res += piece.isWhite() ? "P" : "p";
-            } else if ( piece.isKnight() ) {
-                res += piece.isWhite() ? "N" : "n";
-            } else if ( piece.isBishop() ) {
-                res += piece.isWhite() ? "B" : "b";
-            } else if ( piece.isRook() ) {
-                res += piece.isWhite() ? "R" : "r";
-            } else if ( piece.isQueen() ) {
-                res += piece.isWhite() ? "Q" : "q";
-            } else if (piece.isKing()) {
-                res += piece.isWhite() ? "K" : "k";
-            }
-
-            // Print / at the end of a rank unless rank is 0
-            if (fileOnRank == 7 && rank != 0) {
-                res += "/";
-            }
-
-            fileOnRank++;
-        }
-        
-        rank--;
-        fileOnRank = 0;
-    }
+    char buf[FEN_BUFFER_SIZE];
+    return std::string(buf, formatFEN(buf));
+}
 
-    res += " ";
+PackedPosition Board::pack() const {
+    PackedPosition packed = {};
 
-    // Print the side to move
-    if (pos.sideToMove() == White)
-        res += "w";
-    else
-        res += "b";
-
-    res += " ";
-
-    // Print castling rights
-    std::uint8_t castling = pos.castling();
-    if (castling == NoCastlingFlags) {
-        res += "-";
-    } else {
-        if (castling & CastlingFlagWK)
-            res += "K";
-        if (castling & CastlingFlagWQ)
-            res += "Q";
-        if (castling & CastlingFlagBK)
-            res += "k";
-        if (castling & CastlingFlagBQ)
-            res += "q";
+    packed.occupancy = occupied();
+
+    int n = 0;
+    Bitboard bb = packed.occupancy;
+    foreach_pop_lsb(square, bb) {
+        const Piece piece = pieceAt(square);
+        const std::uint8_t code = (piece.color() << 3) | piece.type();
+        assert(n < 32);
+        packed.pieces[n / 2] |= (n & 1) ? code << 4 : code;
+        n++;
     }
 
+    packed.flags = std::uint8_t(side) | (castling() << 1);
+    packed.epSquare = enPassantSq();
+    packed.halfmoveClock = halfmove_clock();
 
-    res += " ";
+    return packed;
+}
 
-    // Print en passant square
-    Square enPassant = pos.enPassantSq(); 
-    if ( enPassant != NOT_ENPASSANT_SQ ) {
-        char symbolic[3] = "";
-        symbolic[0] = 'a' + enPassant.file();
-        symbolic[1] = '1' + enPassant.rank();
-        res += symbolic;
-    } else {
-        res += "-";
+void Board::unpack(const PackedPosition& packed) {
+    static_cast<Position&>(*this) = Position();
+    moves_done.clear();
+    state_stack.clear();
+    captured_pieses.clear();
+    nnue::accumulators().clear();
+
+    int n = 0;
+    Bitboard bb = packed.occupancy;
+    foreach_pop_lsb(square, bb) {
+        const std::uint8_t code = (n & 1) ? packed.pieces[n / 2] >> 4 : packed.pieces[n / 2] & 0x0F;
+        setPiece(PieceColor(code >> 3), PieceType(code & 0x07), square);
+        n++;
     }
 
-    res += " ";
-    
-    // Print halfmove_clock
-    res += std::to_string(pos.halfmove_clock());
-
-    res += " ";
-    
-    // Print move count
-    res += "0";
-
+    setSideToMove(PieceColor(packed.flags & 1));
+    state.castle_rights = packed.flags >> 1;
+    state.epSquare = packed.epSquare;
+    state.halfmove_clock = packed.halfmoveClock;
 
-    return res;
+    state.hash = hashPosition(*this);
 }
 
-
 Board Board::startpos() {
     return Board::fromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
 }
@@ -12,6 +12,7 @@
 #include "movegen.h"
 #include "evaluate.h"
 #include "tt.h"
+#include "packed.h"
 
 class Board : public Position
 {
@@ -24,49 +25,59 @@ public:
 
 public:
     Board();
+    explicit Board(std::uint64_t ttSizeMb);
     ~Board();
     void moveDo(Move move);
     void moveUndo();
 
+    // Make/unmake for a known side, Color is the side making the move
+    template <PieceColor Color>
+    void moveDo(Move move);
+
+    template <PieceColor Color>
+    void moveUndo();
+
+    // Copy-make, the state is kept for repetition detection and the caller restores from a copy of the parent
+    void moveDoCopy(Move move);
+    void moveUndoCopy(const Position& parent);
+
     void moveDoNull();
     void moveUndoNull();
 
     bool detectRepetition() const;
 
+    // Makes room for plies more moves on the stacks (and the NNUE accumulators), so a search doesn't allocate
+    void reserveStack(std::size_t plies);
+
     inline TT* ttable() { return table.get(); }
 
     std::vector<Move> getPrimaryVariation();
 
-    static Board fromFEN(std::string fenRecord);
+    // Board of a FEN record known to be valid, asserts otherwise
+    static Board fromFEN(std::string_view fenRecord);
+
+    // Replaces the position by the one in the FEN record, the transposition table is kept,
+    // the board is left unchanged if the record is invalid
+    FenResult setFromFEN(std::string_view fenRecord);
     std::string toFEN() const;
+
+    PackedPosition pack() const;
+
+    // Replaces the position by the packed one, the transposition table is kept
+    void unpack(const PackedPosition& packed);
     
     static Board startpos();
 
     // Generate zobrist key for position pos
     static Key hashPosition(const Position& pos);
 
-    template <PieceColor Color>
-    uint32_t getMobilityScore();
-
-    template <PieceColor Color>
-    inline uint32_t getMobilityForKnight(Square origin);
-
-    template <PieceColor Color>
-    inline uint32_t getMobilityForBishop(Square origin);
-
-    template <PieceColor Color>
-    inline uint32_t getMobilityForRook(Square origin);
-
-    template <PieceColor Color>
-    inline uint32_t getMobilityForQueen(Square origin);
-
     // Evaluates the current position and returns a value in centipawns
     Value evaluate();
     
     // Search for the best move
     uint64_t search(ExtMove& result, int depth = 5);
 
-    friend int main();
+    friend int main(int argc, char* argv[]);
 };
 
 /* -- 
@@ -90,53 +101,4 @@ inline bool Board::detectRepetition() const {
     return false;
 }
 
-template <PieceColor Color>
-uint32_t Board::getMobilityScore() {
-    
-    constexpr PieceColor Ally = Color == White ? White : Black;
-    Position& pos = *this;
-    
-    find_pinned_pieces<Ally>(pos);
-    return mobility_score_for<Ally>(pos);
-}
-
-template <PieceColor Color>
-inline uint32_t Board::getMobilityForKnight(Square origin) {
-    
-    constexpr PieceColor Ally = Color == White ? White : Black;
-    Position& pos = *this;
-
-    find_pinned_pieces<Ally>(pos);
-    return mobility_for_knight<Ally>(pos, origin);
-}
-
-template <PieceColor Color>
-uint32_t Board::getMobilityForBishop(Square origin) {
-    constexpr PieceColor Ally = Color == White ? White : Black;
-    Position& pos = *this;
-
-    find_pinned_pieces<Ally>(pos);
-    return mobility_for_bishop<Ally>(pos, origin);
-}
-
-template <PieceColor Color>
-uint32_t Board::getMobilityForRook(Square origin) {
-    constexpr PieceColor Ally = Color == White ? White : Black;
-    Position& pos = *this;
-    
-    find_pinned_pieces<Ally>(pos);
-    return mobility_for_rook<Ally>(pos, origin);
-}
-
-template <PieceColor Color>
-uint32_t Board::getMobilityForQueen(Square origin) {
-    constexpr PieceColor Ally = Color == White ? White : Black;
-    Position& pos = *this;
-
-    find_pinned_pieces<Ally>(pos);
-    return mobility_for_queen<Ally>(pos, origin);
-}
-
-
-
 #endif // BOARD_H
@@ -0,0 +1,6 @@
+#include "evalcache.h"
+
+EvalCache& eval_cache() {
+    thread_local EvalCache cache;
+    return cache;
+}
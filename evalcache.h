@@ -0,0 +1,55 @@
+#ifndef EVALCACHE_H
+#define EVALCACHE_H
+
+#include "types.h"
+
+#include <vector>
+
+/*---------------------
+ -- Evaluation cache --
+ --------------------*/
+
+/* --
+-- Caches the static evaluation of the positions keyed by their zobrist hash
+-- Each entry packs the upper 16 bits of the key and the 16 bit evaluation into one 32 bit word,
+-- so an entry is always read and written as a whole and the table needs no locking
+-- */
+class EvalCache {
+    static constexpr int SIZE_LOG2 = 18;    // number of entries, 2^SIZE_LOG2
+
+    std::vector<std::uint32_t> table;
+
+public:
+    std::uint64_t probes = 0;
+    std::uint64_t hits = 0;
+
+    EvalCache() : table(std::size_t(1) << SIZE_LOG2, 0) {}
+
+    /*-- Returns true and the cached evaluation as arg if the position is in the cache --*/
+    inline bool probe(Key key, Score& eval) {
+        const std::uint32_t entry = table[key & ((1 << SIZE_LOG2) - 1)];
+        probes++;
+        if ( (entry >> 16) == (key >> 48) && entry != 0 ) {
+            hits++;
+            eval = std::int16_t(entry & 0xFFFF);
+            return true;
+        }
+        return false;
+    }
+
+    /*-- Saves the evaluation of a position, evaluations outside of the 16 bit range aren't cached --*/
+    inline void save(Key key, Score eval) {
+        if ( eval < INT16_MIN || eval > INT16_MAX )
+            return;
+        table[key & ((1 << SIZE_LOG2) - 1)] = std::uint32_t(key >> 48) << 16 | std::uint16_t(eval);
+    }
+
+    inline void clear() {
+        std::fill(table.begin(), table.end(), 0);
+    }
+};
+
+/*-- Evaluation cache of the calling thread --*/
+EvalCache& eval_cache();
+
+#endif
@@ -3,291 +3,404 @@
 
 #include "position.h"
 #include "movegen.h"
+#include "pawns.h"
+#include "material.h"
+#include "evalcache.h"
+#include "nnue.h"
 
 /*---------------
  -- Evaluation --
  --------------*/
 
 /*--
--- Piece Weights for material calucaltion in centipawns
--- Details for weights at https://www.chessprogramming.org/Simplified_Evaluation_Function
+-- Evaluation context, built once for each call of evaluate() and shared by all the evaluation terms
 --*/
-const static int PieceWeight[TYPE_CNT] = {
-    0,       // Empty
-    100,     // Pawn
-    320,     // Knight,
-    330,     // Bishop,     
-    500,     // Rook, 
-    900,     // Queen
-    0,       // King
+struct EvalContext {
+    const MaterialEntry* material;              // cached material situation of the position
+    const PawnEntry* pawns;                     // cached pawn structure of the position
+    Bitboard pawnAttacks[COLOR_CNT];            // squares attacked by the pawns of each side
+    Bitboard mobilityArea[COLOR_CNT];           // squares counted for the mobility of each side
+    Bitboard pinned[COLOR_CNT];                 // absolutely pinned pieces of each side
+    Square   kingSquare[COLOR_CNT];
+    Bitboard kingZone[COLOR_CNT];               // king square and the adjacent squares
+    Bitboard bishopOccupied[COLOR_CNT];         // occupancy seen by our bishops, they look through our queen
+    Bitboard rookOccupied[COLOR_CNT];           // occupancy seen by our rooks, they look through our queen and rooks
+    Bitboard attackedBy[COLOR_CNT][TYPE_CNT];   // squares reached by the pieces of a type, [Empty] holds all of them
 };
 
+inline void init_eval_context(EvalContext& ctx, const Position& pos);
+inline void init_eval_context_pieces(EvalContext& ctx, const Position& pos);
 
-template <PieceColor Color> inline uint32_t mobility_score_for(const Position& pos);
-template <PieceColor Color> inline uint32_t mobility_for_knight(const Position& pos, Square origin);
-template <PieceColor Color> inline uint32_t mobility_for_bishop(const Position& pos, Square origin);
-template <PieceColor Color> inline uint32_t mobility_for_rook(const Position& pos, Square origin);
-template <PieceColor Color> inline uint32_t mobility_for_queen(const Position& pos, Square origin);
+struct EvalTrace;
+template <PieceColor Color, bool Trace> inline uint32_t mobility_score_for(EvalContext& ctx, const Position& pos, EvalTrace* trace);
 
 // Helper, Finds all blocked pawns for the side Us
 template <PieceColor Us> inline Bitboard blockedPawns(const Position& pos);
 
-// Evaluates a position from the perspective of the side to move, consideres material and mobility.
-inline Score evaluate(Position& pos) {
-
+// Weight of one extra square reached by a piece for mobility calculation
+constexpr Score MobilityWeight = 1;
 
-    // Weight of one extra square reached by a piece for mobility calculation
-    const int MobilityWeight = 1;
+/*-- The mobility skipped by the lazy evaluation is assumed to stay within this margin --*/
+constexpr Score LAZY_EVAL_MARGIN = 150;
 
-    Score materialScore = 0;
-
-    for (PieceType pt = Pawn; pt < King; pt = PieceType(pt + 1)) {
-        materialScore += PieceWeight[pt] * (popcount_bb(pos.pieces(White, pt)) - popcount_bb(pos.pieces(Black, pt)));
+/*--
+-- Counters of the lazy evaluation, the error distribution is only collected with LAZY_EVAL_STATS
+--*/
+struct LazyEvalStats {
+    static constexpr int BUCKET_WIDTH = 16;             // centipawns per bucket of the error histogram
+    static constexpr int BUCKET_CNT = 16;               // the last bucket takes all the larger errors
+
+    std::uint64_t evals = 0;                            // evaluations that were not found in the cache
+    std::uint64_t exits = 0;                            // of them returned by the lazy exit
+    std::uint64_t wrong = 0;                            // lazy exits whose full evaluation was not outside the window
+    std::uint64_t errors[BUCKET_CNT] = {};              // histogram of |full - lazy|
+    Score maxError = 0;
+
+    inline void record(Score lazy, Score full, Score alpha, Score beta) {
+        const Score error = std::abs(full - lazy);
+        errors[std::min(error / BUCKET_WIDTH, BUCKET_CNT - 1)]++;
+        maxError = std::max(maxError, error);
+        if (lazy >= beta ? full < beta : full > alpha)
+            wrong++;
     }
 
-    find_pinned_pieces<White>(pos);
-    Score whiteMobility = mobility_score_for<White>(pos);
+    inline void clear() { *this = LazyEvalStats(); }
+};
 
-    find_pinned_pieces<Black>(pos);
-    Score blackMobility = mobility_score_for<Black>(pos);
+/*-- Lazy evaluation counters of the calling thread --*/
+inline LazyEvalStats& lazy_eval_stats() {
+    thread_local LazyEvalStats stats;
+    return stats;
+}
 
-    Score mobilityScore = MobilityWeight * (whiteMobility - blackMobility);
+/*-- Terms of the handcrafted evaluation recorded by the trace --*/
+enum EvalTerm : std::uint8_t {
+    TermMaterial, TermImbalance, TermPsqt, TermPawns, TermMobility,
+    ////////////////////////////////////////////////////////////////
+    TERM_CNT
+};
 
-    Score totalScore = materialScore + mobilityScore;
+/*--
+-- Everything computed by one evaluate<true> call. Side values are from the side's own point of view,
+-- totals and scores from White's. Tapered sides may differ from the total by rounding.
+--*/
+struct EvalTrace {
+    enum Evaluator : std::uint8_t { Handcrafted, KnownEndgame, Network };
+
+    struct PieceMobility {
+        PieceColor color;
+        PieceType  type;
+        Square     square;
+        int        mobility;               // squares reached inside the mobility area
+    };
+
+    Evaluator evaluator = Handcrafted;
+    int       phase = 0;
+    int       scale = SCALE_NORMAL;         // drawish material scale of the side ahead
+    Score     side[TERM_CNT][COLOR_CNT] = {};
+    bool      hasSides[TERM_CNT] = {};      // false for the terms only computed as a difference
+    Score     total[TERM_CNT] = {};
+    Score     score = 0;                    // final score before the side to move sign
+    std::vector<PieceMobility> mobility;
+
+    inline void set(EvalTerm term, Score white, Score black, Score difference) {
+        side[term][White] = white;
+        side[term][Black] = black;
+        hasSides[term] = true;
+        total[term] = difference;
+    }
+};
 
-    return totalScore * (pos.blacks_turn() ? -1 : 1);
+template <bool Trace>
+inline Score evaluate_uncached(Position& pos, Score alpha, Score beta, bool& exact, EvalTrace* trace);
+
+/* --
+-- Evaluates a position from the perspective of the side to move, the evaluation cache is consulted first.
+-- evaluate<true> bypasses the cache and records every term into trace.
+-- */
+template <bool Trace>
+inline Score evaluate(Position& pos, EvalTrace* trace = nullptr) {
+    bool exact;
+
+    if constexpr (Trace) {
+        return evaluate_uncached<true>(pos, -CHECKMATE_SCORE, CHECKMATE_SCORE, exact, trace);
+    } else {
+        Score eval;
+        if (eval_cache().probe(pos.hash(), eval))
+            return eval;
+
+        eval = evaluate_uncached<false>(pos, -CHECKMATE_SCORE, CHECKMATE_SCORE, exact, nullptr);
+        eval_cache().save(pos.hash(), eval);
+        return eval;
+    }
 }
 
+inline Score evaluate(Position& pos) {
+    return evaluate<false>(pos);
+}
 
-template <PieceColor Color>
-inline uint32_t mobility_score_for(const Position&  pos) {
-    constexpr PieceColor Ally = Color == White ? White : Black;
-
-    uint32_t mobility = 0;
+/* --
+-- Lazy evaluation for the window [alpha, beta], if the material, piece-square and pawn terms
+-- are beyond the window by LAZY_EVAL_MARGIN they are returned without the mobility terms.
+-- Such an estimate is not cached.
+-- */
+inline Score evaluate(Position& pos, Score alpha, Score beta) {
+    Score eval;
+    if (eval_cache().probe(pos.hash(), eval))
+        return eval;
+
+    bool exact;
+    eval = evaluate_uncached<false>(pos, alpha, beta, exact, nullptr);
+
+    LazyEvalStats& stats = lazy_eval_stats();
+    stats.evals++;
+
+    if (exact) {
+        eval_cache().save(pos.hash(), eval);
+        return eval;
+    }
 
-    Bitboard allyKnights = pos.pieces(Ally, Knight);
-    Bitboard allyBishops = pos.pieces(Ally, Bishop);
-    Bitboard allyRooks = pos.pieces(Ally, Rook);
-    Bitboard allyQueens = pos.pieces(Ally, Queen);
+    stats.exits++;
+#ifdef LAZY_EVAL_STATS
+    Score full = evaluate_uncached<false>(pos, -CHECKMATE_SCORE, CHECKMATE_SCORE, exact, nullptr);
+    stats.record(eval, full, alpha, beta);
+#endif
+    return eval;
+}
 
-    foreach_pop_lsb(origin, allyKnights) {
-        mobility += mobility_for_knight<Ally>(pos, origin);
+// Piece-square sum of one side from its own point of view, the position only keeps the difference
+inline Score psqt_side(const Position& pos, PieceColor color, int phase) {
+    const int sign = color == White ? 1 : -1;
+    int mg = 0, eg = 0;
+    for (PieceType pt = Pawn; pt < TYPE_CNT; pt = PieceType(pt + 1)) {
+        Bitboard pieces = pos.pieces(color, pt);
+        foreach_pop_lsb(sq, pieces) {
+            mg += sign * PSQT::mg[color][pt][sq];
+            eg += sign * PSQT::eg[color][pt][sq];
+        }
     }
+    return taperedScore(mg, eg, phase);
+}
 
-    foreach_pop_lsb(origin, allyBishops) {
-        mobility += mobility_for_bishop<Ally>(pos, origin);
-    }
+// Evaluates a position from the perspective of the side to move, consideres material, piece-square tables, pawn structure and mobility.
+// exact is false if the lazy exit skipped the mobility terms, the trace never takes the lazy exit
+template <bool Trace>
+inline Score evaluate_uncached(Position& pos, Score alpha, Score beta, bool& exact, EvalTrace* trace) {
 
-    foreach_pop_lsb(origin, allyRooks) {
-        mobility += mobility_for_rook<Ally>(pos, origin);
-    }
+    exact = true;
 
-    foreach_pop_lsb(origin, allyQueens) {
-        mobility += mobility_for_queen<Ally>(pos, origin);
-    }
+    EvalContext ctx;
+    ctx.material = material_table().probe(pos);
 
-    return mobility;
-}
+    // Known endgames have their own evaluation
+    if (ctx.material->evaluator) {
+        Score score = ctx.material->evaluator(pos, ctx.material->strongSide);
+        if constexpr (Trace) {
+            trace->evaluator = EvalTrace::KnownEndgame;
+            trace->score = score;
+        }
+        return score * (pos.blacks_turn() ? -1 : 1);
+    }
 
-template <PieceColor Color>
-inline uint32_t mobility_for_knight(const Position& pos, Square origin) {
-    // Our pawns in rank 2 and 3, blocked pawns and our king are excluded from mobility area.
-    // All pieces consider enemy piece attack as mobility area.
-    // All can attack their own pieces for mobility calculation(except pawns blocked and in rank 2 and 3 and our king)
-    // All pieces do not take squares attacked by enemy pawn in the mobility area.
-    // Knights can attack our knight, queen, bishops and rooks for mobility.
-    // Knights only take into account enemy pawns, not queen, rooks, bishops, knights, king etc
+    // The network replaces the handcrafted terms, drawish material still scales its score
+    if (nnue::active()) {
+        Score score = nnue::evaluate(pos);
+        score = score * ctx.material->scale(pos, score > 0 ? pos.stm() : !pos.stm()) / SCALE_NORMAL;
+        if constexpr (Trace) {
+            trace->evaluator = EvalTrace::Network;
+            trace->score = score * (pos.blacks_turn() ? -1 : 1);
+        }
+        return score;
+    }
 
-    assert(pos.pieceAt(origin).type() == Knight);
+    const int phase = ctx.material->phase;
 
-    constexpr PieceColor Ally = Color == White ? White : Black;
-    constexpr PieceColor Enemy = Color == White ? Black : White;
+    // Material and piece-square sums are kept up to date by the position
+    Score materialScore = pos.material(White) - pos.material(Black) + ctx.material->imbalance;
+    Score psqtScore = taperedScore(pos.psqtMg(), pos.psqtEg(), phase);
 
-    constexpr Bitboard Ranks2and3 = Color == White ? (Rank2_bb | Rank3_bb) : (Rank7_bb | Rank6_bb);
+    ctx.pawns = pawn_table().probe(pos);
+    Score pawnScore = taperedScore(ctx.pawns->mg, ctx.pawns->eg, phase);
 
-    const Bitboard Occupied = pos.occupied();
-    const Bitboard enemyPawnAttacks = pawnsCaptureEast<Enemy>(pos) | pawnsCaptureWest<Enemy>(pos);
-    const Bitboard BlockedPawns = blockedPawns<Ally>(pos);
+    if constexpr (Trace) {
+        Score mg[COLOR_CNT], eg[COLOR_CNT];
+        PawnTable::evaluate_pawns_side(pos, White, mg[White], eg[White]);
+        PawnTable::evaluate_pawns_side(pos, Black, mg[Black], eg[Black]);
 
+        trace->phase = phase;
+        trace->set(TermMaterial, pos.material(White), pos.material(Black), pos.material(White) - pos.material(Black));
+        trace->total[TermImbalance] = ctx.material->imbalance;
+        trace->set(TermPsqt, psqt_side(pos, White, phase), psqt_side(pos, Black, phase), psqtScore);
+        trace->set(TermPawns, taperedScore(mg[White], eg[White], phase), taperedScore(mg[Black], eg[Black], phase), pawnScore);
+    }
 
-    uint32_t mobility = 0;
+    // Lazy exit, the mobility and pin terms can't bring the score back into the window
+    if constexpr (!Trace) {
+        Score lazyScore = materialScore + psqtScore + pawnScore;
+        lazyScore = lazyScore * ctx.material->scale(pos, lazyScore > 0 ? White : Black) / SCALE_NORMAL;
+        lazyScore *= pos.blacks_turn() ? -1 : 1;
+        if (lazyScore - LAZY_EVAL_MARGIN >= beta || lazyScore + LAZY_EVAL_MARGIN <= alpha) {
+            exact = false;
+            return lazyScore;
+        }
+    }
 
-    if (isAbsolutelyPinned<Ally>(pos, origin, NO_DIRECTION))
-        return mobility;
+    init_eval_context_pieces(ctx, pos);
 
-    const Bitboard excluded =
-        (pos.pieces(Ally, Pawn) & (Ranks2and3)) |   // Our pawns in rank 2 and 3
-        pos.pieces(Ally, King) |                    // our king
-        BlockedPawns |                              // blocked pawns
-        enemyPawnAttacks;                           // attacked by enemy pawn
+    Score whiteMobility = mobility_score_for<White, Trace>(ctx, pos, trace);
+    Score blackMobility = mobility_score_for<Black, Trace>(ctx, pos, trace);
 
-    Bitboard stepsOn = knightStepsBB[origin];
+    Score mobilityScore = MobilityWeight * (whiteMobility - blackMobility);
 
-    // Knights can attack our knight, queen, bishops and rooks for mobility.
-    // Knights can attack their own pieces for mobility calculation(TODO: except pawns blocked and in rank 2 and 3 and our king)
-    stepsOn &= ~excluded;
+    Score totalScore = materialScore + psqtScore + pawnScore + mobilityScore;
 
-    mobility += popcount_bb(stepsOn);
+    // Drawish material scales the score of the stronger side down
+    const int scale = ctx.material->scale(pos, totalScore > 0 ? White : Black);
+    totalScore = totalScore * scale / SCALE_NORMAL;
 
+    if constexpr (Trace) {
+        trace->set(TermMobility, MobilityWeight * whiteMobility, MobilityWeight * blackMobility, mobilityScore);
+        trace->scale = scale;
+        trace->score = totalScore;
+    }
 
-    return mobility;
+    return totalScore * (pos.blacks_turn() ? -1 : 1);
 }
 
 template <PieceColor Color>
-inline uint32_t mobility_for_bishop(const Position& pos, Square origin) {
+inline void init_eval_context_for(EvalContext& ctx, const Position& pos) {
     // Our pawns in rank 2 and 3, blocked pawns and our king are excluded from mobility area.
-    // All pieces consider enemy piece attack as mobility area.
-    // All can attack their own pieces for mobility calculation (except pawns blocked and in rank 2 and 3 and our king)
     // All pieces do not take squares attacked by enemy pawn in the mobility area.
-    // Bishop can attack our knight, bishop and rooks for mobility.
-    // Bishop does not consider attack from enemy queen or rooks or bishop or knight or king.
-    // Bishops can look through our queen.
-
-    assert(pos.pieceAt(origin).type() == Bishop);
+    // All can attack their own pieces for mobility calculation (except pawns blocked and in rank 2 and 3 and our king)
 
     constexpr PieceColor Ally = Color == White ? White : Black;
     constexpr PieceColor Enemy = Color == White ? Black : White;
 
-    constexpr Direction DirectionStart = NorthWest;     // Start with diagolnal x-direction eg queen and bishop
-    constexpr std::uint8_t DirectionIncrement = 2;      // rotate by 90� for rook and bishop
-
     constexpr Bitboard Ranks2and3 = Color == White ? (Rank2_bb | Rank3_bb) : (Rank7_bb | Rank6_bb);
 
-    const Bitboard Occupied = pos.occupied();
-    const Bitboard enemyPawnAttacks = pawnsCaptureEast<Enemy>(pos) | pawnsCaptureWest<Enemy>(pos);
-    const Bitboard BlockedPawns = blockedPawns<Ally>(pos);
-
-    // Bishops can look throught our queen
-    const Bitboard OccupiedNoQueen = Occupied ^ pos.pieces(Ally, Queen);
-
-    uint32_t mobility = 0;
-
     const Bitboard excluded =
         (pos.pieces(Ally, Pawn) & (Ranks2and3)) |   // Our pawns in rank 2 and 3
         pos.pieces(Ally, King) |                    // our king
-        BlockedPawns |                              // blocked pawns
-        enemyPawnAttacks;                           // attacked by enemy pawn
-
-    for (Direction dir = DirectionStart; dir < DIRECTION_CNT; dir = Direction(dir + DirectionIncrement)) {
+        blockedPawns<Ally>(pos) |                   // blocked pawns
+        ctx.pawnAttacks[Enemy];                     // attacked by enemy pawn
 
-        if (isAbsolutelyPinned<Ally>(pos, origin, dir))
-            continue;
+    ctx.mobilityArea[Ally] = ~excluded;
+    ctx.pinned[Ally] = pinned_pieces<Ally>(pos);
 
-        Bitboard stepsOn = rayPieceSteps(OccupiedNoQueen, origin, dir);
+    ctx.kingSquare[Ally] = lsb_bb(pos.pieces(Ally, King));
+    ctx.kingZone[Ally] = kingStepsBB[ctx.kingSquare[Ally]] | SHL(1, ctx.kingSquare[Ally]);
 
-        // Bishops consider enemy piece attack as mobility area.
-        // Bishop can attack our knight, bishop and rooks for mobility.
-        // Bishop can attack their own pieces for mobility calculation
-        stepsOn &= ~excluded;
+    ctx.bishopOccupied[Ally] = pos.occupied() ^ pos.pieces(Ally, Queen);
+    ctx.rookOccupied[Ally]   = pos.occupied() ^ (pos.pieces(Ally, Queen) | pos.pieces(Ally, Rook));
 
-        mobility += popcount_bb(stepsOn);
-    }
+    // piece attacks are added by the mobility terms
+    for (PieceType pt = Empty; pt < TYPE_CNT; pt = PieceType(pt + 1))
+        ctx.attackedBy[Ally][pt] = Empty_bb;
 
-    return mobility;
+    ctx.attackedBy[Ally][Pawn] = ctx.pawnAttacks[Ally];
+    ctx.attackedBy[Ally][King] = kingStepsBB[ctx.kingSquare[Ally]];
+    ctx.attackedBy[Ally][Empty] = ctx.attackedBy[Ally][Pawn] | ctx.attackedBy[Ally][King];
 }
 
-template <PieceColor Color>
-inline uint32_t mobility_for_rook(const Position& pos, Square origin) {
-    // Our pawns in rank 2 and 3, blocked pawns and our king are excluded from mobility area.
-    // All pieces consider enemy piece attack as mobility area.
-    // All can attack their own pieces for mobility calculation(except pawns blocked and in rank 2 and 3 and our king)
-    // All pieces do not take squares attacked by enemy pawn in the mobility area.
-    // Rooks can look through our queen and rook.
-    // Rook does not consider attack from enemy queen or rooks or bishop or knight or king.
-    
-    assert(pos.pieceAt(origin).type() == Rook);
-
-    constexpr PieceColor Ally = Color == White ? White : Black;
-    constexpr PieceColor Enemy = Color == White ? Black : White;
-
-    constexpr Direction DirectionStart = North;     // Start with vertival direction eg rook
-    constexpr std::uint8_t DirectionIncrement = 2;  // rotate by 90� for rook and bishop
-
-    constexpr Bitboard Ranks2and3 = Color == White ? (Rank2_bb | Rank3_bb) : (Rank7_bb | Rank6_bb);
-
-    const Bitboard Occupied = pos.occupied();
-    const Bitboard enemyPawnAttacks = pawnsCaptureEast<Enemy>(pos) | pawnsCaptureWest<Enemy>(pos);
-    const Bitboard BlockedPawns = blockedPawns<Ally>(pos);
-
-    // Rooks can look through our queenand rook
-    const Bitboard OccupiedNoQueenAndRook = Occupied ^ (pos.pieces(Ally, Queen) | pos.pieces(Ally, Rook));
-
-    uint32_t mobility = 0;
+// Fills the piece part of the context, the pawn entry has to be probed already
+inline void init_eval_context_pieces(EvalContext& ctx, const Position& pos) {
 
-    const Bitboard excluded =
-        (pos.pieces(Ally, Pawn) & (Ranks2and3)) |   // Our pawns in rank 2 and 3
-        pos.pieces(Ally, King) |                    // our king
-        BlockedPawns |                              // blocked pawns
-        enemyPawnAttacks;                           // attacked by enemy pawn
+    ctx.pawnAttacks[White] = ctx.pawns->pawnAttacks[White];
+    ctx.pawnAttacks[Black] = ctx.pawns->pawnAttacks[Black];
 
-    for (Direction dir = DirectionStart; dir < DIRECTION_CNT; dir = Direction(dir + DirectionIncrement)) {
+    init_eval_context_for<White>(ctx, pos);
+    init_eval_context_for<Black>(ctx, pos);
+}
 
-        if (isAbsolutelyPinned<Ally>(pos, origin, dir))
-            continue;
+inline void init_eval_context(EvalContext& ctx, const Position& pos) {
+    ctx.pawns = pawn_table().probe(pos);
+    init_eval_context_pieces(ctx, pos);
+}
 
-        // Rooks can look through our queenand rook
-        Bitboard stepsOn = rayPieceSteps(OccupiedNoQueenAndRook, origin, dir);
+/* --
+-- Squares a piece of the side Color may reach, a pinned piece only moves along the line of the pin
+-- */
+template <PieceColor Color>
+inline Bitboard pin_restriction(const EvalContext& ctx, Square origin) {
+    return is_set_bb(ctx.pinned[Color], origin)
+        ? lineBB(ctx.kingSquare[Color], origin)
+        : Universe_bb;
+}
 
-        // Rooks consider enemy piece attack as mobility area.
-        // Rooks can attack our knight, bishop and rooks for mobility.
-        // Rooks can attack their own pieces for mobility calculation
-        stepsOn &= ~excluded;
+template <PieceColor Color>
+inline Bitboard mobility_attacks_knight(const EvalContext& ctx, Square origin) {
+    // A pinned knight can never move along the line of the pin
+    return is_set_bb(ctx.pinned[Color], origin) ? Empty_bb : knightStepsBB[origin];
+}
 
-        mobility += popcount_bb(stepsOn);
-    }
+template <PieceColor Color>
+inline Bitboard mobility_attacks_bishop(const EvalContext& ctx, Square origin) {
+    // Bishops can look through our queen
+    return bishopAttacks(ctx.bishopOccupied[Color], origin) & pin_restriction<Color>(ctx, origin);
+}
 
-    return mobility;
+template <PieceColor Color>
+inline Bitboard mobility_attacks_rook(const EvalContext& ctx, Square origin) {
+    // Rooks can look through our queen and rook
+    return rookAttacks(ctx.rookOccupied[Color], origin) & pin_restriction<Color>(ctx, origin);
 }
 
 template <PieceColor Color>
-inline uint32_t mobility_for_queen(const Position& pos, Square origin) {
-    // Our pawns in rank 2 and 3, blocked pawns and our king are excluded from mobility area.
-    // All pieces consider enemy piece attack as mobility area.
-    // All can attack their own pieces for mobility calculation(except pawns blocked and in rank 2 and 3 and our king)
-    // All pieces do not take squares attacked by enemy pawn in the mobility area.
-    // TODO: Queen takes into account attacks from enemy bishop, knight and rook. Not enemy queen or king.
+inline Bitboard mobility_attacks_queen(const EvalContext& ctx, const Position& pos, Square origin) {
     // Queen cannot look through our rook or bishop.
+    // TODO: Queen takes into account attacks from enemy bishop, knight and rook. Not enemy queen or king.
+    const Bitboard Occupied = pos.occupied();
+    return (bishopAttacks(Occupied, origin) | rookAttacks(Occupied, origin)) & pin_restriction<Color>(ctx, origin);
+}
 
-    assert(pos.pieceAt(origin).type() == Queen);
-
+template <PieceColor Color, bool Trace>
+inline uint32_t mobility_score_for(EvalContext& ctx, const Position& pos, EvalTrace* trace) {
     constexpr PieceColor Ally = Color == White ? White : Black;
-    constexpr PieceColor Enemy = Color == White ? Black : White;
-
-    constexpr Direction DirectionStart = NorthWest;   // Start with diagolnal x-direction eg queen and bishop
-    constexpr std::uint8_t DirectionIncrement = 1;    // rotate by 45� for queen
-
-    constexpr Bitboard Ranks2and3 = Color == White ? (Rank2_bb | Rank3_bb) : (Rank7_bb | Rank6_bb);
 
-    const Bitboard Occupied = pos.occupied();
-    const Bitboard enemyPawnAttacks = pawnsCaptureEast<Enemy>(pos) | pawnsCaptureWest<Enemy>(pos);
-    const Bitboard BlockedPawns = blockedPawns<Ally>(pos);
+    const Bitboard area = ctx.mobilityArea[Ally];
 
     uint32_t mobility = 0;
 
-    const Bitboard excluded =
-        (pos.pieces(Ally, Pawn) & (Ranks2and3)) |   // Our pawns in rank 2 and 3
-        pos.pieces(Ally, King) |                    // our king
-        BlockedPawns |                              // blocked pawns
-        enemyPawnAttacks;                           // attacked by enemy pawn
-
-    // TODO: Queen takes into account attacks from enemy bishop, knight and rook. Not enemy queen or king.
-
-    for (Direction dir = DirectionStart; dir < DIRECTION_CNT; dir = Direction(dir + DirectionIncrement)) {
+    Bitboard allyKnights = pos.pieces(Ally, Knight);
+    Bitboard allyBishops = pos.pieces(Ally, Bishop);
+    Bitboard allyRooks = pos.pieces(Ally, Rook);
+    Bitboard allyQueens = pos.pieces(Ally, Queen);
 
-        if (isAbsolutelyPinned<Ally>(pos, origin, dir))
-            continue;
+    foreach_pop_lsb(origin, allyKnights) {
+        const Bitboard attacks = mobility_attacks_knight<Ally>(ctx, origin);
+        ctx.attackedBy[Ally][Knight] |= attacks;
+        mobility += popcount_bb(attacks & area);
+        if constexpr (Trace)
+            trace->mobility.push_back({ Ally, Knight, origin, popcount_bb(attacks & area) });
+    }
 
-        // Rooks can look through our queenand rook
-        Bitboard stepsOn = rayPieceSteps(Occupied, origin, dir);
+    foreach_pop_lsb(origin, allyBishops) {
+        const Bitboard attacks = mobility_attacks_bishop<Ally>(ctx, origin);
+        ctx.attackedBy[Ally][Bishop] |= attacks;
+        mobility += popcount_bb(attacks & area);
+        if constexpr (Trace)
+            trace->mobility.push_back({ Ally, Bishop, origin, popcount_bb(attacks & area) });
+    }
 
-        // Queens consider enemy piece attack as mobility area.
-        // Queens can attack our knight, bishop and rooks for mobility.
-        // Queens can attack their own pieces for mobility calculation
-        stepsOn &= ~excluded;
+    foreach_pop_lsb(origin, allyRooks) {
+        const Bitboard attacks = mobility_attacks_rook<Ally>(ctx, origin);
+        ctx.attackedBy[Ally][Rook] |= attacks;
+        mobility += popcount_bb(attacks & area);
+        if constexpr (Trace)
+            trace->mobility.push_back({ Ally, Rook, origin, popcount_bb(attacks & area) });
+    }
 
-        mobility += popcount_bb(stepsOn);
+    foreach_pop_lsb(origin, allyQueens) {
+        const Bitboard attacks = mobility_attacks_queen<Ally>(ctx, pos, origin);
+        ctx.attackedBy[Ally][Queen] |= attacks;
+        mobility += popcount_bb(attacks & area);
+        if constexpr (Trace)
+            trace->mobility.push_back({ Ally, Queen, origin, popcount_bb(attacks & area) });
     }
 
+    ctx.attackedBy[Ally][Empty] |= ctx.attackedBy[Ally][Knight] | ctx.attackedBy[Ally][Bishop]
+                                 | ctx.attackedBy[Ally][Rook] | ctx.attackedBy[Ally][Queen];
+
     return mobility;
 }
 
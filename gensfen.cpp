@@ -0,0 +1,224 @@
+#include "gensfen.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "search.h"
+#include "util.h"
+
+namespace {
+
+const char* const START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Positions of one finished game
+using Game = std::vector<TrainingRecord>;
+
+/* --
+-- Bounded multi-producer single-consumer queue (D. Vyukov's bounded queue)
+-- Each cell carries a sequence number telling whether it can be written or read at the current position,
+-- so the producers only contend on the compare-exchange of the enqueue position and never wait on a lock
+-- */
+template <typename T>
+class BoundedQueue {
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    const std::size_t mask;
+
+    alignas(64) std::atomic<std::size_t> enqueuePos;
+    alignas(64) std::size_t dequeuePos;
+
+public:
+    // capacity must be a power of two
+    explicit BoundedQueue(std::size_t capacity)
+        : cells(new Cell[capacity]), mask(capacity - 1), enqueuePos(0), dequeuePos(0) {
+        assert((capacity & mask) == 0);
+        for (std::size_t i = 0; i < capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /*-- Returns false if the queue is full, value is moved from only on success --*/
+    bool push(T&& value) {
+        std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const std::intptr_t diff = std::intptr_t(sequence) - std::intptr_t(pos);
+
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*-- Returns false if the queue is empty, only one thread may pop --*/
+    bool pop(T& value) {
+        Cell& cell = cells[dequeuePos & mask];
+        const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+
+        if (sequence != dequeuePos + 1)
+            return false;
+
+        value = std::move(cell.data);
+        cell.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+        dequeuePos++;
+        return true;
+    }
+};
+
+// Only the kings and at most a minor piece for each side are left
+bool insufficient_material(const Position& pos) {
+    return !pos.pieces(Pawn) && pos.material(White) <= PieceWeight[Bishop] && pos.material(Black) <= PieceWeight[Bishop];
+}
+
+/* --
+-- Plays a game from the current position of the board with random opening moves first,
+-- the board is returned to the position it started from. The game is left empty if the
+-- search couldn't finish its first iteration within the node limit.
+-- */
+void play_game(Board& board, const GensfenOptions& options, Game& game) {
+    game.clear();
+
+    for (int ply = 0; ply < options.randomPlies; ply++) {
+        const Move move = randomMove(board);
+        if (move == NullMove)
+            break;
+        board.moveDo(move);
+    }
+
+    int result = 0; // from White's point of view
+
+    for (;;) {
+        MoveList moves;
+        generate_all_moves(board, moves);
+
+        const PieceColor us = board.stm();
+        const bool inCheck = IsKingInCheck(board);
+
+        if (moves.empty()) {
+            result = !inCheck ? 0 : us == White ? -1 : 1;
+            break;
+        }
+
+        if (board.halfmove_clock() >= 100 || board.detectRepetition() || insufficient_material(board)
+            || int(board.moves_done.size()) >= options.maxPlies)
+            break;
+
+        ExtMove best;
+        search_fixed(board, best, options.depth, options.nodes);
+
+        if (!best.move.isValid()) {
+            game.clear();
+            break;
+        }
+
+        // adjudicate, mate scores are beyond the limit as well so they never get recorded
+        if (std::abs(best.score) >= options.evalLimit) {
+            result = (best.score > 0) == (us == White) ? 1 : -1;
+            break;
+        }
+
+        if (!inCheck)
+            game.push_back({ board.pack(), std::int16_t(best.score), std::uint16_t(board.moves_done.size()), 0, {} });
+
+        board.moveDo(best.move);
+    }
+
+    for (TrainingRecord& record : game)
+        record.result = std::int8_t(PieceColor(record.pos.flags & 1) == White ? result : -result);
+
+    while (!board.moves_done.empty())
+        board.moveUndo();
+}
+
+void play_games(const GensfenOptions& options, std::atomic<int>& gamesLeft, BoundedQueue<Game>& queue) {
+    Board board(options.hashMb);
+    board.setFromFEN(START_FEN);
+
+    Game game;
+    while (gamesLeft.fetch_sub(1, std::memory_order_relaxed) > 0) {
+        play_game(board, options, game);
+
+        while (!queue.push(std::move(game)))
+            std::this_thread::yield();
+
+        game = Game();
+    }
+}
+
+} // namespace
+
+void gensfen(const std::string& path, const GensfenOptions& options) {
+    RecordWriter<TrainingRecord> writer;
+    if (!writer.open(path, true)) {
+        cout << "info string error cannot open " << path << endl;
+        return;
+    }
+
+    BoundedQueue<Game> queue(1024);
+    std::atomic<int> gamesLeft(options.games);
+    std::atomic<int> running(options.threads);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; t++) {
+        workers.emplace_back([&]() {
+            play_games(options, gamesLeft, queue);
+            running--;
+        });
+    }
+
+    const uint64_t startTime = now_time_ms();
+    uint64_t reportTime = startTime;
+    uint64_t games = 0;
+    uint64_t positions = 0;
+
+    auto report = [&]() {
+        const uint64_t delta_ms = std::max<uint64_t>(now_time_ms() - startTime, 1);
+        cout << "info string gensfen games " << games << " positions " << positions
+             << " time " << delta_ms << " pps " << positions * 1000 / delta_ms << endl;
+    };
+
+    // the games are written in the order they finish
+    Game game;
+    for (;;) {
+        // every game is pushed before its worker finishes, so the queue is complete once they are all done
+        const bool done = running.load() == 0;
+
+        if (queue.pop(game)) {
+            writer.write(game.data(), game.size());
+            games++;
+            positions += game.size();
+        } else if (done) {
+            break;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        if (now_time_ms() - reportTime >= 10000) {
+            reportTime = now_time_ms();
+            report();
+        }
+    }
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    writer.close();
+    report();
+    cout << "info string gensfen wrote " << path << endl;
+}
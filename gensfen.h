@@ -0,0 +1,42 @@
+#ifndef GENSFEN_H
+#define GENSFEN_H
+
+#include "types.h"
+#include "packed.h"
+
+#include <string>
+
+/*---------------------------------
+ -- Self-play training data generation --
+ --------------------------------*/
+
+/*-- A searched position of a self-play game, the score and the result are from the side to move's point of view --*/
+struct TrainingRecord {
+    PackedPosition pos;
+    std::int16_t   score;       // search score in centipawns
+    std::uint16_t  ply;         // plies played since the start position
+    std::int8_t    result;      // 1 win, 0 draw, -1 loss
+    std::uint8_t   reserved[3];
+};
+static_assert(sizeof(TrainingRecord) == 40, "the training records are written as is");
+
+struct GensfenOptions {
+    int           games = 1000;
+    int           depth = 6;            // fixed search depth, 0 for no depth limit
+    std::uint64_t nodes = 0;            // fixed search nodes, 0 for no node limit
+    int           threads = 1;
+    int           randomPlies = 8;      // random moves played from the start position before the search takes over
+    int           maxPlies = 400;       // the game is drawn after this many plies
+    int           evalLimit = 3000;     // the game is adjudicated once the score gets beyond it
+    std::uint64_t hashMb = 16;          // transposition table of each worker
+};
+
+/* --
+-- Plays the games on all threads and appends the positions to the file as TrainingRecords.
+-- Every worker plays on its own Board and transposition table, the finished games are passed
+-- through a lock-free queue to the calling thread which is the only one writing the file.
+-- Positions in check are not recorded, they aren't quiet and the search extends them anyway.
+-- */
+void gensfen(const std::string& path, const GensfenOptions& options);
+
+#endif // GENSFEN_H
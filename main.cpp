@@ -1,5 +1,7 @@
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <algorithm>
 
 #include <thread>
 
@@ -8,13 +10,18 @@
 #include "util.h"
 #include "engine.h"
 #include "search.h"
+#include "tune.h"
+#include "gensfen.h"
+#include "bench.h"
+#include "perfcounters.h"
+#include "timeman.h"
+#include "searchthread.h"
 
 using namespace std;
 
 
-// Reads a command line from the standart input and returns an array of tokens
-vector<string> getCommandArgs(void) {
-    string cmdArgs;
+// Reads a command line from the standart input into cmdArgs and returns an array of tokens
+vector<string> getCommandArgs(string& cmdArgs) {
     
     std::getline(std::cin, cmdArgs);
     istringstream iss(cmdArgs);
@@ -28,7 +35,7 @@ vector<string> getCommandArgs(void) {
 }
 
 // Reads UCI go commands from the standart input and returns a search request struct.
-SearchRequest getSearchRequestArgs(vector<string>& args) {
+SearchRequest getSearchRequestArgs(Board& board, vector<string>& args) {
     
     SearchRequest result;
 
@@ -69,7 +76,19 @@ SearchRequest getSearchRequestArgs(vector<string>& args) {
             result.limits |= NodesLimit;
             i++;
         } else if ( arg == "infinite" ) {
+            result.infinite = true;
             result.limits |= InfiniteLimit;
+        } else if ( arg == "ponder" ) {
+            result.ponder = true;
+        } else if ( arg == "searchmoves" ) {
+            // the moves follow up to the next argument that isn't a legal move
+            while ( i + 1 < args.size() ) {
+                const Move mv = verify_move(board, args[i + 1]);
+                if ( !mv.isValid() )
+                    break;
+                result.searchmoves.push_back(mv);
+                i++;
+            }
         } else {
             cout << "info string error unknown go arg " << arg << endl;
         }
@@ -97,8 +116,23 @@ Board getBoardFromMoves(vector<string> uciMoves, Board startPos = Board::startpo
 
 
 
-int main()
+// bench [hash] [threads] [depth], the arguments follow the command name in args
+void runBench(const vector<string>& args) {
+    uint64_t hashMb = args.size() >= 2 ? std::stoull(args[1]) : 16;
+    int threads = args.size() >= 3 ? std::stoi(args[2]) : 1;
+    int depth = args.size() >= 4 ? std::stoi(args[3]) : 8;
+    PerfScope perf;
+    perf.report(bench(hashMb, threads, depth));
+}
+
+int main(int argc, char* argv[])
 {
+    // ./MyChessEngine bench [hash] [threads] [depth] runs the benchmark and exits
+    if ( argc >= 2 && string(argv[1]) == "bench" ) {
+        runBench(vector<string>(argv + 1, argv + argc));
+        return 0;
+    }
+
     Board board = Board::fromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");    
     
     /*Initial
@@ -121,14 +155,62 @@ int main()
     
     //cout.imbue(std::locale("")); // use commas to decorate large integers
 
+    // the handcrafted evaluation is used when there is no network
+    nnue::gNetwork.load(nnue::DEFAULT_FILE);
+
+    string line;
+
+    // the searches run on their own thread, so stop and ponderhit can be read while searching
+    SearchThread searchThread;
+
     while ( 1 ) {
-        vector<string> args = getCommandArgs();
+        vector<string> args = getCommandArgs(line);
+
+        // end of the input, a running search is finished first
+        if ( args.empty() && !std::cin )
+            break;
+
+        // the board belongs to the search until its bestmove, other commands wait for it
+        const bool searchCommand = args.size() == 1 && (args[0] == "stop" || args[0] == "ponderhit" || args[0] == "isready");
+        if ( !args.empty() && !searchCommand )
+            searchThread.finish();
+
         if ( args.size() == 1 && args[0] == "uci" ) {
             cout << "id name ChessZombie v0.14" << endl;
             cout << "id author dobrovv" << endl;
+            cout << "option name EvalFile type string default " << nnue::DEFAULT_FILE << endl;
+            cout << "option name PerfCounters type check default false" << endl;
+            cout << "option name SearchStats type check default false" << endl;
+            cout << "option name Move Overhead type spin default " << gMoveOverhead << " min 0 max 5000" << endl;
+            cout << "option name Ponder type check default false" << endl;
+            cout << "option name MultiPV type spin default 1 min 1 max " << MAX_MULTIPV << endl;
             cout << "uciok" << endl;
         } else if (args.size() == 1 && args[0] == "isready" ) {
             cout << "readyok" << endl;
+        } else if ( args.size() >= 4 && args[0] == "setoption" && args[1] == "name" && args[2] == "EvalFile" && args[3] == "value" ) {
+            // an empty value or <empty> switches back to the handcrafted evaluation
+            string path = args.size() >= 5 && args[4] != "<empty>" ? args[4] : "";
+            if ( path.empty() ) {
+                nnue::gNetwork.unload();
+                cout << "info string using the handcrafted evaluation" << endl;
+            } else if ( nnue::gNetwork.load(path) ) {
+                cout << "info string loaded network " << path << endl;
+            } else {
+                cout << "info string error cannot load network " << path << ", using the handcrafted evaluation" << endl;
+            }
+            eval_cache().clear();
+            searchThread.clear_caches();
+        } else if ( args.size() == 5 && args[0] == "setoption" && args[1] == "name" && args[2] == "PerfCounters" && args[3] == "value" ) {
+            // counts the hardware events of the searches, perft and bench, see perfcounters.h
+            gPerfCounters = args[4] == "true";
+        } else if ( args.size() == 5 && args[0] == "setoption" && args[1] == "name" && args[2] == "SearchStats" && args[3] == "value" ) {
+            // per iteration statistics of the tree and a JSON dump of them at the end of each search
+            gSearchStats = args[4] == "true";
+        } else if ( args.size() == 6 && args[0] == "setoption" && args[1] == "name" && args[2] == "Move" && args[3] == "Overhead" && args[4] == "value" ) {
+            gMoveOverhead = std::min<Time>(std::stoull(args[5]), 5000);
+        } else if ( args.size() == 5 && args[0] == "setoption" && args[1] == "name" && args[2] == "MultiPV" && args[3] == "value" ) {
+            // the best lines printed as info multipv, the bestmove is the one of the first line
+            gMultiPV = std::clamp(std::stoi(args[4]), 1, MAX_MULTIPV);
         } else if ( args.size() == 2 && args[0] == "position" && args[1] == "startpos" ) {
             board = getBoardFromMoves(vector<string>());
         }
@@ -138,24 +220,24 @@ int main()
             //print_board_with_files(board) << "\n";
         }
         else if (args.size() >= 2 && args[0] == "position" && args[1] == "fen") {
-            std::stringstream fenSS;
             vector<string> moves;
             
-            // read fen arguments
-            int i;
-            
-            for (i = 2; i < args.size(); i++) {
-                if (args[i] != "moves") {
-                    fenSS << args[i] << " ";
-                }
-                else break;
+            // the FEN is parsed in place from the command line, it ends where the moves start
+            const std::string_view cmd(line);
+            const std::size_t fenBegin = cmd.find("fen") + 3;
+            const std::string_view fen = cmd.substr(fenBegin, cmd.find(" moves", fenBegin) - fenBegin);
+
+            auto movesIt = std::find(args.begin() + 2, args.end(), "moves");
+            if ( movesIt != args.end() ) {
+                moves = std::vector<string>(movesIt + 1, args.end());
             }
             
-            if (i < args.size() && args[i] == "moves") {
-                moves = std::vector<string>(args.begin() + i + 1, args.end());
+            Board startPos;
+            const FenResult parsed = startPos.setFromFEN(fen);
+            if ( !parsed ) {
+                cout << "info string error invalid fen, " << fen_error_string(parsed.error) << " at offset " << parsed.offset << endl;
+                continue;
             }
-            
-            Board startPos = Board::fromFEN(fenSS.str());
             board = getBoardFromMoves(moves, startPos);
             //print_board_with_files(board) << "\n";
 
@@ -169,78 +251,22 @@ int main()
             //cout << "E.p file and rank: " << (char)('a' + board.state.epSquare.file()) << " " << (int)(board.state.epSquare.rank() + 1) << endl;
             //cout << "Pinned pieces" << endl; print_bb(board.pinned_bb);
         }
-        else if (args.size() == 1 && args[0] == "eval") {
-            cout << "Evaluation: " << board.evaluate() << "cp" << endl;
-            
-            Bitboard allyKnights = board.pieces(White, Knight);
-            Bitboard allyBishops = board.pieces(White, Bishop);
-            Bitboard allyRooks = board.pieces(White, Rook);
-            Bitboard allyQueens = board.pieces(White, Queen);
-            
-            cout << "-----------------------" << endl;
-            foreach_pop_lsb(origin, allyKnights) {
-                cout << "Knight at ";
-                print_square(origin);
-                cout << " mobility " << board.getMobilityForKnight<White>(origin) << endl;
-            }
-
-            foreach_pop_lsb(origin, allyBishops) {
-                cout << "Bishop at ";
-                print_square(origin);
-                cout << " mobility " << board.getMobilityForBishop<White>(origin) << endl;
-            }
-
-            foreach_pop_lsb(origin, allyRooks) {
-                cout << "Rook at ";
-                print_square(origin);
-                cout << " mobility " << board.getMobilityForRook<White>(origin) << endl;
-            }
-
-            foreach_pop_lsb(origin, allyQueens) {
-                cout << "Queen at ";
-                print_square(origin);
-                cout << " mobility " << board.getMobilityForQueen<White>(origin) << endl;
-            }
-            
-            cout << "-----------------------" << endl;
-
-            allyKnights = board.pieces(Black, Knight);
-            allyBishops = board.pieces(Black, Bishop);
-            allyRooks = board.pieces(Black, Rook);
-            allyQueens = board.pieces(Black, Queen);
-
-            foreach_pop_lsb(origin, allyKnights) {
-                cout << "Knight at ";
-                print_square(origin);
-                cout << " mobility " << board.getMobilityForKnight<Black>(origin) << endl;
-            }
-
-            foreach_pop_lsb(origin, allyBishops) {
-                cout << "Bishop at ";
-                print_square(origin);
-                cout << " mobility " << board.getMobilityForBishop<Black>(origin) << endl;
-            }
-
-            foreach_pop_lsb(origin, allyRooks) {
-                cout << "Rook at ";
-                print_square(origin);
-                cout << " mobility " << board.getMobilityForRook<Black>(origin) << endl;
-            }
-
-            foreach_pop_lsb(origin, allyQueens) {
-                cout << "Queen at ";
-                print_square(origin);
-                cout << " mobility " << board.getMobilityForQueen<Black>(origin) << endl;
-            }
-
-            cout << "-----------------------" << endl;
-
+        else if (args.size() >= 1 && args[0] == "eval") {
+            // eval prints the terms as a table, eval json as one JSON line
+            EvalTrace trace;
+            evaluate<true>(board, &trace);
+            if (args.size() >= 2 && args[1] == "json")
+                print_eval_trace_json(trace, board.stm());
+            else
+                print_eval_trace(trace, board.stm());
         }
         else if ((args.size() == 3 && args[0] == "go" && args[1] == "perft")) {
             int depth = std::stoi(args[2]);
+            PerfScope perf;
             auto start_time = std::chrono::high_resolution_clock::now();
             uint64_t result = divide(board, depth);
             auto stop_time = std::chrono::high_resolution_clock::now();
+            perf.report(result);
 
             int delta_ms = std::chrono::duration_cast<std::chrono::milliseconds>(stop_time - start_time).count();
             delta_ms = std::max(delta_ms, 1); // prevent the good old divide by 0 problem :)
@@ -248,9 +274,38 @@ int main()
             cout << "Perft(" << depth << "): " << result << " nodes " << delta_ms << "ms " << (result / delta_ms * 1000) << " nodes/s" << endl;
             cout << " " << endl;
         }
+        else if ( args.size() >= 2 && args[0] == "tune" ) {
+            // tune <dataset.epd> [epochs] [threads]
+            int epochs = args.size() >= 3 ? std::stoi(args[2]) : 100;
+            int threads = args.size() >= 4 ? std::stoi(args[3]) : std::max(1u, std::thread::hardware_concurrency());
+            tune(args[1], epochs, threads);
+        }
+        else if ( args.size() >= 2 && args[0] == "gensfen" ) {
+            // gensfen <output.bin> [games] [depth] [threads] [nodes], a depth of 0 searches by nodes only
+            GensfenOptions options;
+            options.games = args.size() >= 3 ? std::stoi(args[2]) : options.games;
+            options.depth = args.size() >= 4 ? std::stoi(args[3]) : options.depth;
+            options.threads = args.size() >= 5 ? std::stoi(args[4]) : std::max(1u, std::thread::hardware_concurrency());
+            options.nodes = args.size() >= 6 ? std::stoull(args[5]) : options.nodes;
+            if ( !options.depth && !options.nodes ) {
+                cout << "info string error gensfen needs a depth or a node limit" << endl;
+                continue;
+            }
+            gensfen(args[1], options);
+        }
+        else if ( args.size() >= 1 && args[0] == "bench" ) {
+            runBench(args);
+        }
+        else if ( args.size() == 2 && args[0] == "perftcmp" ) {
+            perft_compare(board, std::stoi(args[1]));
+        }
         else if ( args.size() >= 2 && args[0] == "d") {
             if ( args.size() >= 3 && args[1] == "piece" ) {
                 int piece = std::stoi(args[2]);
+                if ( piece < Pawn || piece > King ) {
+                    cout << "info string error piece type must be in range [" << (int)Pawn << ", " << (int)King << "]" << endl;
+                    continue;
+                }
                 cout << "White" << endl;
                 print_bb(board.pieces(White,(PieceType)piece));
                 cout << "Black" << endl;
@@ -266,11 +321,14 @@ int main()
         }
         else if ( args.size() >= 1 && args[0] == "go" ) {
             
-            ExtMove result;
-            start_search(board, result, getSearchRequestArgs(args));
+            searchThread.go(board, getSearchRequestArgs(board, args));
         
+        } else if ( args.size() == 1 && args[0] == "stop" ) {
+            searchThread.stop();
+        } else if ( args.size() == 1 && args[0] == "ponderhit" ) {
+            searchThread.ponderhit();
         } else if (args.size() == 1 && (args[0] == "q" || args[0] == "quit" || args[0] == "exit")) {
-            exit(0);
+            break;
         } else if (args.size() == 1 && args[0] == "test") {
             do_tests();
         } else {
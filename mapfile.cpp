@@ -0,0 +1,62 @@
+#include "mapfile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void* map_file(const std::string& path, std::size_t& size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if ( file == INVALID_HANDLE_VALUE )
+        return nullptr;
+
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    if ( GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 )
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    void* ptr = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+    // the view keeps the mapping alive
+    if ( mapping ) CloseHandle(mapping);
+    CloseHandle(file);
+
+    size = ptr ? std::size_t(fileSize.QuadPart) : 0;
+    return ptr;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if ( fd == -1 )
+        return nullptr;
+
+    struct stat st;
+    void* ptr = nullptr;
+    if ( fstat(fd, &st) == 0 && st.st_size > 0 ) {
+        ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( ptr == MAP_FAILED )
+            ptr = nullptr;
+        else
+            madvise(ptr, st.st_size, MADV_WILLNEED);
+    }
+    close(fd);
+
+    size = ptr ? std::size_t(st.st_size) : 0;
+    return ptr;
+#endif
+}
+
+void unmap_file(void* ptr, std::size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(ptr);
+#else
+    munmap(ptr, size);
+#endif
+}
@@ -0,0 +1,16 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <cstddef>
+#include <string>
+
+/*-------------------------
+ -- Memory mapped files --
+ ------------------------*/
+
+// Maps the whole file read-only, returns nullptr on failure or if the file is empty
+void* map_file(const std::string& path, std::size_t& size);
+
+void unmap_file(void* ptr, std::size_t size);
+
+#endif // MAPFILE_H
@@ -0,0 +1,120 @@
+#include "material.h"
+
+/*-- Non pawn material of the side color --*/
+static int non_pawn_material(Key key, PieceColor color) {
+    int npm = 0;
+    for (PieceType pt = Knight; pt < King; pt = PieceType(pt + 1))
+        npm += PieceWeight[pt] * materialCount(key, color, pt);
+    return npm;
+}
+
+/*-- Distance of a square from the center, 0 in the center and 3 on the edge --*/
+static int center_distance(Square sq) {
+    return std::max(3 - std::min<int>(sq.file(), 7 - sq.file()), 3 - std::min<int>(sq.rank(), 7 - sq.rank()));
+}
+
+/* --
+-- KXK, mating material against a lone king
+-- Drives the weak king to the edge and brings the strong king closer
+-- */
+static Score evaluate_KXK(const Position& pos, PieceColor strongSide) {
+    const Square strongKing = lsb_bb(pos.pieces(strongSide, King));
+    const Square weakKing = lsb_bb(pos.pieces(!strongSide, King));
+
+    Score score = KNOWN_WIN_SCORE + pos.material(strongSide)
+        + 40 * center_distance(weakKing)
+        + 10 * (7 - strongKing.chessboardDistance(weakKing));
+
+    return strongSide == White ? score : -score;
+}
+
+/* --
+-- KBNK, bishop and knight against a lone king
+-- The mate is only possible in a corner of the same color as the bishop
+-- */
+static Score evaluate_KBNK(const Position& pos, PieceColor strongSide) {
+    const Square strongKing = lsb_bb(pos.pieces(strongSide, King));
+    const Square weakKing = lsb_bb(pos.pieces(!strongSide, King));
+    const Square bishop = lsb_bb(pos.pieces(strongSide, Bishop));
+
+    // a1 is a dark square, dark squares have an even sum of file and rank
+    const bool darkBishop = (bishop.file() + bishop.rank()) % 2 == 0;
+    const Square corner1 = darkBishop ? Square(a1) : Square(h1);
+    const Square corner2 = darkBishop ? Square(h8) : Square(a8);
+    const int cornerDistance = std::min(weakKing.chessboardDistance(corner1), weakKing.chessboardDistance(corner2));
+
+    Score score = KNOWN_WIN_SCORE + pos.material(strongSide)
+        + 40 * (7 - cornerDistance)
+        + 10 * (7 - strongKing.chessboardDistance(weakKing));
+
+    return strongSide == White ? score : -score;
+}
+
+/* --
+-- Opposite colored bishops with pawns only are drawish
+-- */
+static int scale_opposite_bishops(const Position& pos, int factor) {
+    const Square whiteBishop = lsb_bb(pos.pieces(White, Bishop));
+    const Square blackBishop = lsb_bb(pos.pieces(Black, Bishop));
+
+    const bool opposite = ((whiteBishop.file() + whiteBishop.rank()) % 2) != ((blackBishop.file() + blackBishop.rank()) % 2);
+    return opposite ? std::min(factor, SCALE_NORMAL / 2) : factor;
+}
+
+void MaterialTable::analyze_material(Key key, MaterialEntry& entry) {
+
+    entry.key = key;
+    entry.imbalance = 0;
+    entry.phase = 0;
+    entry.factor[White] = entry.factor[Black] = SCALE_NORMAL;
+    entry.strongSide = White;
+    entry.evaluator = nullptr;
+    entry.scaleFunc = nullptr;
+
+    for (PieceType pt = Pawn; pt < King; pt = PieceType(pt + 1))
+        entry.phase += PhaseWeight[pt] * (materialCount(key, White, pt) + materialCount(key, Black, pt));
+
+    if (materialCount(key, White, Bishop) >= 2)
+        entry.imbalance += BishopPairBonus;
+    if (materialCount(key, Black, Bishop) >= 2)
+        entry.imbalance -= BishopPairBonus;
+
+    for (PieceColor color : { White, Black }) {
+        const PieceColor weak = !color;
+        const int npmStrong = non_pawn_material(key, color);
+        const int npmWeak = non_pawn_material(key, weak);
+        const int pawnsStrong = materialCount(key, color, Pawn);
+        const int knightsStrong = materialCount(key, color, Knight);
+        const bool weakBareKing = npmWeak == 0 && materialCount(key, weak, Pawn) == 0;
+
+        // specialized endgames against a lone king, knights alone can't force the mate
+        if (weakBareKing && pawnsStrong == 0 && materialCount(key, color, Bishop) == 1
+            && materialCount(key, color, Knight) == 1 && npmStrong == PieceWeight[Bishop] + PieceWeight[Knight]) {
+            entry.evaluator = evaluate_KBNK;
+            entry.strongSide = color;
+        } else if (weakBareKing && (npmStrong - knightsStrong * PieceWeight[Knight] >= PieceWeight[Rook]
+                                    || materialCount(key, color, Bishop) >= 2)) {
+            entry.evaluator = evaluate_KXK;
+            entry.strongSide = color;
+        }
+
+        // without pawns a small material advantage can't win
+        if (pawnsStrong == 0 && npmStrong - npmWeak <= PieceWeight[Bishop])
+            entry.factor[color] = npmStrong < PieceWeight[Rook] ? SCALE_DRAW : SCALE_NORMAL / 4;
+
+        // two knights can't mate a bare king
+        if (weakBareKing && pawnsStrong == 0 && knightsStrong == 2 && npmStrong == 2 * PieceWeight[Knight])
+            entry.factor[color] = SCALE_DRAW;
+    }
+
+    // a single bishop for each side and only pawns otherwise
+    const bool bishopsOnly = materialCount(key, White, Bishop) == 1 && materialCount(key, Black, Bishop) == 1
+        && non_pawn_material(key, White) == PieceWeight[Bishop] && non_pawn_material(key, Black) == PieceWeight[Bishop];
+    if (bishopsOnly)
+        entry.scaleFunc = scale_opposite_bishops;
+}
+
+MaterialTable& material_table() {
+    thread_local MaterialTable table;
+    return table;
+}
@@ -0,0 +1,90 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include "types.h"
+#include "bitboard.h"
+#include "position.h"
+
+#include <vector>
+
+/*----------------------------
+ -- Material signature hash --
+ ---------------------------*/
+
+/*-- Scale factor of the evaluation, SCALE_NORMAL keeps the score as it is --*/
+constexpr int SCALE_DRAW = 0;
+constexpr int SCALE_NORMAL = 64;
+
+/*-- Score of a won endgame without a mate found by the search yet --*/
+constexpr Score KNOWN_WIN_SCORE = 5000;
+
+/*-- Bonus for the pair of bishops from White's point of view --*/
+constexpr Score BishopPairBonus = 30;
+
+/*-- Specialized evaluation of an endgame, from White's point of view --*/
+using EndgameEval = Score (*)(const Position& pos, PieceColor strongSide);
+
+/*-- Scale factor depending on the placement of the pieces, returns at most the given factor --*/
+using ScaleFunc = int (*)(const Position& pos, int factor);
+
+/* --
+-- Entry of the material table, keyed by the material key (the piece counts) of the position
+-- */
+struct MaterialEntry {
+    Key          key;
+    Score        imbalance;             // material imbalance score from White's point of view
+    std::uint8_t phase;                 // game phase of the material
+    std::uint8_t factor[COLOR_CNT];     // scale factor when the side is the stronger one
+    PieceColor   strongSide;            // side with the upper hand for the endgame evaluator
+    EndgameEval  evaluator;             // replaces the evaluation if set
+    ScaleFunc    scaleFunc;             // refines the scale factor if set
+
+    /*-- Scale factor for the evaluation when the side strongSide has the better score --*/
+    inline int scale(const Position& pos, PieceColor strongSide) const {
+        return scaleFunc ? scaleFunc(pos, factor[strongSide]) : factor[strongSide];
+    }
+};
+
+/* --
+-- The material situation only changes on captures and promotions, so
+-- imbalance, phase and the endgame type are computed once per material key
+-- */
+class MaterialTable {
+    static constexpr int SIZE_LOG2 = 13;    // number of entries, 2^SIZE_LOG2
+
+    std::vector<MaterialEntry> table;
+
+public:
+    std::uint64_t probes = 0;
+    std::uint64_t hits = 0;
+
+    MaterialTable() : table(std::size_t(1) << SIZE_LOG2) {
+        clear();
+    }
+
+    inline void clear() {
+        // no position has this key, an empty table never hits
+        for (MaterialEntry& entry : table)
+            entry.key = ~Key(0);
+    }
+
+    /*-- Returns the entry of the position, analyzes the material on a miss --*/
+    inline const MaterialEntry* probe(const Position& pos) {
+        const Key key = pos.materialKey();
+        MaterialEntry* entry = &table[(key * 0x9E3779B97F4A7C15ULL) >> (64 - SIZE_LOG2)];
+        probes++;
+        if (entry->key == key) {
+            hits++;
+            return entry;
+        }
+        analyze_material(key, *entry);
+        return entry;
+    }
+
+    static void analyze_material(Key key, MaterialEntry& entry);
+};
+
+/*-- Material table of the calling thread --*/
+MaterialTable& material_table();
+
+#endif
@@ -0,0 +1,201 @@
+/*-----------------------------------------
+ -- Micro-benchmarks of the hot primitives --
+ ----------------------------------------*/
+
+/* --
+-- Times the primitives of the search one by one over a corpus of positions, the bench positions and
+-- the positions of short seeded random games played from them. Every benchmark runs once to warm up
+-- the caches and then the given number of repetitions, each repetition is timed as a whole and
+-- reported in ns per operation. The checksum of the warm-up run only depends on the work done,
+-- so it has to match between the builds which are compared.
+--
+-- usage: engine_microbench [repetitions=20] [filter]
+-- */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "bench.h"
+#include "util.h"
+
+namespace {
+
+constexpr int RANDOM_PLIES = 20;    // plies of the random game played from each bench position
+
+struct Corpus {
+    std::vector<Board>    boards;           // with the history of their game, for detectRepetition
+    std::vector<std::vector<Move>> moves;   // legal moves of each board, a MoveList always takes room for 256
+    std::vector<Key>      ttKeys;           // random keys spread over the whole transposition table
+    std::uint64_t         moveCnt = 0;
+};
+
+Corpus build_corpus() {
+    Corpus corpus;
+    std::mt19937 rng(20241019);
+
+    // the copies share the table of this board, the search primitives don't use it
+    Board board(1);
+    for (int i = 0; i < BENCH_POSITION_CNT; i++) {
+        board.setFromFEN(BenchPositions[i]);
+
+        for (int ply = 0; ply <= RANDOM_PLIES; ply++) {
+            MoveList moveList;
+            generate_all_moves(board, moveList);
+
+            corpus.boards.push_back(board);
+            corpus.moves.emplace_back(moveList.begin(), moveList.end());
+            corpus.moveCnt += moveList.size();
+
+            if (moveList.empty())
+                break;
+            board.moveDo(moveList[rng() % moveList.size()]);
+        }
+    }
+
+    std::mt19937_64 rng64(20241019);
+    corpus.ttKeys.resize(1 << 20);
+    for (Key& key : corpus.ttKeys)
+        key = rng64();
+
+    return corpus;
+}
+
+struct Benchmark {
+    const char* name;
+    std::uint64_t ops;                              // operations of one repetition
+    std::function<std::uint64_t()> run;             // runs one repetition and returns its checksum
+};
+
+// keeps the results of the timed repetitions alive
+volatile std::uint64_t gSink;
+
+void run_benchmark(const Benchmark& bm, int repetitions) {
+    using clock = std::chrono::steady_clock;
+
+    const std::uint64_t checksum = bm.run();   // warm-up
+
+    std::vector<double> nsPerOp;
+    for (int r = 0; r < repetitions; r++) {
+        const auto start = clock::now();
+        gSink += bm.run();
+        const auto stop = clock::now();
+        nsPerOp.push_back(std::chrono::duration<double, std::nano>(stop - start).count() / bm.ops);
+    }
+
+    double mean = 0;
+    for (double ns : nsPerOp)
+        mean += ns;
+    mean /= nsPerOp.size();
+
+    double variance = 0;
+    for (double ns : nsPerOp)
+        variance += (ns - mean) * (ns - mean);
+    const double stddev = nsPerOp.size() > 1 ? std::sqrt(variance / (nsPerOp.size() - 1)) : 0;
+
+    const double best = *std::min_element(nsPerOp.begin(), nsPerOp.end());
+
+    std::printf("%-22s %10llu %10.2f %9.2f %10.2f   %016llx\n", bm.name, (unsigned long long)bm.ops,
+                mean, stddev, best, (unsigned long long)checksum);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const int repetitions = argc >= 2 ? std::max(1, std::atoi(argv[1])) : 20;
+    const std::string filter = argc >= 3 ? argv[2] : "";
+
+    TT table(16);
+    Corpus corpus = build_corpus();
+    std::vector<Board>& boards = corpus.boards;
+    const std::uint64_t positions = boards.size();
+
+    std::vector<Benchmark> benchmarks = {
+        { "generate_all_moves", positions, [&]() {
+            std::uint64_t sum = 0;
+            for (Board& b : boards) {
+                MoveList moveList;
+                generate_all_moves(b, moveList);
+                sum += moveList.size();
+            }
+            return sum;
+        } },
+        { "moveDo+moveUndo", corpus.moveCnt, [&]() {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < boards.size(); i++) {
+                Board& b = boards[i];
+                for (Move move : corpus.moves[i]) {
+                    b.moveDo(move);
+                    sum += b.hash();
+                    b.moveUndo();
+                }
+            }
+            return sum;
+        } },
+        { "evaluate", positions, [&]() {
+            std::uint64_t sum = 0;
+            for (Board& b : boards) {
+                bool exact;
+                sum += std::uint64_t(evaluate_uncached<false>(b, -CHECKMATE_SCORE, CHECKMATE_SCORE, exact, nullptr));
+            }
+            return sum;
+        } },
+        { "isAttackedBy", positions * SQUARE_CNT, [&]() {
+            std::uint64_t sum = 0;
+            for (Board& b : boards)
+                for (Square sq = a1; sq < SQUARE_CNT; ++sq)
+                    sum += isAttackedBy(b, !b.stm(), sq);
+            return sum;
+        } },
+        { "find_pinned_pieces", positions, [&]() {
+            std::uint64_t sum = 0;
+            for (Board& b : boards) {
+                if (b.stm() == White)
+                    find_pinned_pieces<White>(b);
+                else
+                    find_pinned_pieces<Black>(b);
+                sum += b.pinned();
+            }
+            return sum;
+        } },
+        { "TT::save", corpus.ttKeys.size(), [&]() {
+            std::uint64_t sum = 0;
+            for (Key key : corpus.ttKeys) {
+                table.save(key, int(key & 15), Score(key >> 54), PV_NODE, Move(std::uint16_t(key)));
+                sum += key & 15;
+            }
+            return sum;
+        } },
+        { "TT::probe", corpus.ttKeys.size(), [&]() {
+            std::uint64_t sum = 0;
+            for (Key key : corpus.ttKeys) {
+                Score score = 0;
+                Move move = NullMove;
+                sum += table.probe(key, 0, -CHECKMATE_SCORE, CHECKMATE_SCORE, score, move) + move.as_bits();
+            }
+            return sum;
+        } },
+        { "detectRepetition", positions, [&]() {
+            std::uint64_t sum = 0;
+            for (const Board& b : boards)
+                sum += b.detectRepetition();
+            return sum;
+        } }
+    };
+
+    std::printf("%zu positions, %zu moves, %d repetitions\n\n", boards.size(), (std::size_t)corpus.moveCnt, repetitions);
+    std::printf("%-22s %10s %10s %9s %10s   %s\n", "benchmark", "ops/rep", "ns/op", "stddev", "min", "checksum");
+
+    for (const Benchmark& bm : benchmarks)
+        if (filter.empty() || std::string(bm.name).find(filter) != std::string::npos)
+            run_benchmark(bm, repetitions);
+
+    return 0;
+}
@@ -1,6 +1,8 @@
 #ifndef MOVEGEN_H
 #define MOVEGEN_H
 
+#include <algorithm>
+
 #include "types.h"
 #include "bitboard.h"
 #include "position.h"
@@ -24,10 +26,24 @@ public:
         end_of_list = &moveList[0];
     }
 
+    // end_of_list points into the own array, a copy must point into its array
+    MoveList(const MoveList& other) {
+        *this = other;
+    }
+
+    MoveList& operator=(const MoveList& other) {
+        end_of_list = std::copy(other.begin(), other.end(), &moveList[0]);
+        return *this;
+    }
+
     inline void emplace_back(Square origin, Square target, MoveType type) {
         *end_of_list++ = SortMove(origin, target, type);
     }
 
+    inline void push_back(Move mv) {
+        *end_of_list++ = SortMove(mv);
+    }
+
     inline bool empty() const {
         return end_of_list == &moveList[0];
     }
@@ -84,6 +100,13 @@ inline void generate_all_moves(Position& pos, MoveList& moveList);
 template<PieceColor Color>
 void find_pinned_pieces(Position& pos);
 
+/*-- Returns the absolutely pinned pieces of the side Color without storing them in the position --*/
+template<PieceColor Color>
+Bitboard pinned_pieces(const Position& pos);
+
+/*-- Directional attack of a piece up to (and including) the first blocker piece --*/
+inline Bitboard rayPieceSteps(const Bitboard occupied, const Square origin, const Direction dir);
+
 /*----------------------------
  -- Move generation helpers --
  ---------------------------*/
@@ -200,6 +223,11 @@ inline void generate_all_moves(Position& pos, MoveList& moveList) {
 
 template<PieceColor Color>
 inline void find_pinned_pieces(Position& pos) {
+    pos.setPinned(pinned_pieces<Color>(pos));
+}
+
+template<PieceColor Color>
+inline Bitboard pinned_pieces(const Position& pos) {
     constexpr PieceColor Ally = Color == White ? White : Black;
     constexpr PieceColor Enemy = Color == White ? Black : White;
 
@@ -235,8 +263,7 @@ inline void find_pinned_pieces(Position& pos) {
         }
     }
 
-    pos.setPinned(pinned_bb);
-
+    return pinned_bb;
 }
 
 /*----------------------------
@@ -260,6 +287,26 @@ inline Bitboard rayPieceSteps(const Bitboard occupied, const Square origin, cons
     return ray;
 }
 
+/*-- All squares attacked by a bishop on square origin --*/
+inline Bitboard bishopAttacks(const Bitboard occupied, const Square origin) {
+    return rayPieceSteps(occupied, origin, NorthWest) | rayPieceSteps(occupied, origin, NorthEast)
+         | rayPieceSteps(occupied, origin, SouthEast) | rayPieceSteps(occupied, origin, SouthWest);
+}
+
+/*-- All squares attacked by a rook on square origin --*/
+inline Bitboard rookAttacks(const Bitboard occupied, const Square origin) {
+    return rayPieceSteps(occupied, origin, North) | rayPieceSteps(occupied, origin, East)
+         | rayPieceSteps(occupied, origin, South) | rayPieceSteps(occupied, origin, West);
+}
+
+/*-- The full line passing through the squares sq1 and sq2, empty if they aren't aligned --*/
+inline Bitboard lineBB(const Square sq1, const Square sq2) {
+    const Direction dir = fromToDirection[sq1][sq2];
+    if (dir == NO_DIRECTION)
+        return Empty_bb;
+    return directionStepsBB[sq1][dir] | directionStepsBB[sq1][invDir(dir)] | SHL(1, sq1);
+}
+
 
 template <PieceColor bySide>
 inline Bitboard attackersOf(const Position& pos, const Square square) {
@@ -0,0 +1,337 @@
+#include "nnue.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#include "mapfile.h"
+
+namespace nnue {
+
+Network gNetwork;
+
+/*-------------------
+ -- Network loading --
+ ------------------*/
+
+bool Network::load(const std::string& path) {
+    unload();
+
+    std::size_t size;
+    void* ptr = map_file(path, size);
+    if ( !ptr )
+        return false;
+
+    const FileHeader* header = static_cast<const FileHeader*>(ptr);
+    if ( size != FILE_SIZE
+      || std::memcmp(header->magic, "CEBBNNUE", sizeof(header->magic)) != 0
+      || header->version    != FILE_VERSION
+      || header->inputDims  != INPUT_DIMS
+      || header->halfDims   != HALF_DIMS
+      || header->hiddenDims != HIDDEN_DIMS ) {
+        unmap_file(ptr, size);
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(ptr) + sizeof(FileHeader);
+
+    ftBias        = reinterpret_cast<const std::int16_t*>(data); data += sizeof(std::int16_t) * HALF_DIMS;
+    ftWeights     = reinterpret_cast<const std::int16_t*>(data); data += sizeof(std::int16_t) * std::size_t(INPUT_DIMS) * HALF_DIMS;
+    hiddenBias    = reinterpret_cast<const std::int32_t*>(data); data += sizeof(std::int32_t) * HIDDEN_DIMS;
+    hiddenWeights = reinterpret_cast<const std::int8_t*>(data);  data += sizeof(std::int8_t) * HIDDEN_DIMS * 2 * HALF_DIMS;
+    outputBias    = reinterpret_cast<const std::int32_t*>(data); data += sizeof(std::int32_t);
+    outputWeights = reinterpret_cast<const std::int8_t*>(data);
+
+    mapping = ptr;
+    mappingSize = size;
+    filePath = path;
+    loadCount++;
+    return true;
+}
+
+void Network::unload() {
+    if ( mapping )
+        unmap_file(mapping, mappingSize);
+
+    mapping = nullptr;
+    mappingSize = 0;
+    filePath.clear();
+    loadCount++;
+    ftBias = ftWeights = nullptr;
+    hiddenBias = outputBias = nullptr;
+    hiddenWeights = outputWeights = nullptr;
+}
+
+/*---------------------------
+ -- SIMD helpers, AVX2/SSE4 --
+ --------------------------*/
+
+#if defined(__AVX2__)
+#define USE_SIMD
+using vec_t = __m256i;
+#define vec_zero()        _mm256_setzero_si256()
+#define vec_load(a)       _mm256_load_si256(a)
+#define vec_loadu(a)      _mm256_loadu_si256(a)
+#define vec_store(a, b)   _mm256_store_si256(a, b)
+#define vec_add_16(a, b)  _mm256_add_epi16(a, b)
+#define vec_sub_16(a, b)  _mm256_sub_epi16(a, b)
+#define vec_add_32(a, b)  _mm256_add_epi32(a, b)
+#define vec_max_8(a, b)   _mm256_max_epi8(a, b)
+#define vec_set1_16(a)    _mm256_set1_epi16(a)
+#define vec_maddubs(a, b) _mm256_maddubs_epi16(a, b)
+#define vec_madd_16(a, b) _mm256_madd_epi16(a, b)
+// packing works within the 128 bit lanes, the permutation restores the order of the elements
+#define vec_packs_16(a, b) _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8)
+
+inline int vec_hsum_32(vec_t v) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+#elif defined(__SSE4_1__)
+#define USE_SIMD
+using vec_t = __m128i;
+#define vec_zero()        _mm_setzero_si128()
+#define vec_load(a)       _mm_load_si128(a)
+#define vec_loadu(a)      _mm_loadu_si128(a)
+#define vec_store(a, b)   _mm_store_si128(a, b)
+#define vec_add_16(a, b)  _mm_add_epi16(a, b)
+#define vec_sub_16(a, b)  _mm_sub_epi16(a, b)
+#define vec_add_32(a, b)  _mm_add_epi32(a, b)
+#define vec_max_8(a, b)   _mm_max_epi8(a, b)
+#define vec_set1_16(a)    _mm_set1_epi16(a)
+#define vec_maddubs(a, b) _mm_maddubs_epi16(a, b)
+#define vec_madd_16(a, b) _mm_madd_epi16(a, b)
+#define vec_packs_16(a, b) _mm_packs_epi16(a, b)
+
+inline int vec_hsum_32(vec_t v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1));
+    return _mm_cvtsi128_si32(v);
+}
+#endif
+
+/*-----------------
+ -- Accumulators --
+ ----------------*/
+
+// More changed pieces than this and the accumulators are recomputed instead of updated
+constexpr int REFRESH_THRESHOLD = 32;
+
+/*-- out = in + rows of the added features - rows of the removed features, in and out may be the same --*/
+static void apply_features(const std::int16_t* in, std::int16_t* out,
+                           const int* added, int addedCnt, const int* removed, int removedCnt) {
+    const std::int16_t* weights = gNetwork.ftWeights;
+#ifdef USE_SIMD
+    constexpr int LANES = sizeof(vec_t) / sizeof(std::int16_t);
+
+    for ( int j = 0; j < HALF_DIMS / LANES; j++ ) {
+        vec_t acc = vec_loadu(reinterpret_cast<const vec_t*>(in) + j);
+
+        for ( int i = 0; i < removedCnt; i++ )
+            acc = vec_sub_16(acc, vec_loadu(reinterpret_cast<const vec_t*>(weights + removed[i] * HALF_DIMS) + j));
+        for ( int i = 0; i < addedCnt; i++ )
+            acc = vec_add_16(acc, vec_loadu(reinterpret_cast<const vec_t*>(weights + added[i] * HALF_DIMS) + j));
+
+        vec_store(reinterpret_cast<vec_t*>(out) + j, acc);
+    }
+#else
+    if ( in != out )
+        std::copy(in, in + HALF_DIMS, out);
+
+    for ( int i = 0; i < removedCnt; i++ ) {
+        const std::int16_t* row = weights + removed[i] * HALF_DIMS;
+        for ( int j = 0; j < HALF_DIMS; j++ )
+            out[j] -= row[j];
+    }
+    for ( int i = 0; i < addedCnt; i++ ) {
+        const std::int16_t* row = weights + added[i] * HALF_DIMS;
+        for ( int j = 0; j < HALF_DIMS; j++ )
+            out[j] += row[j];
+    }
+#endif
+}
+
+static void refresh(Accumulator& acc, const Position& pos, PieceColor perspective) {
+    int features[SQUARE_CNT];
+    int count = 0;
+
+    const Square ksq = lsb_bb(pos.pieces(perspective, King));
+
+    for ( PieceColor color : { White, Black } ) {
+        for ( PieceType type = Pawn; type < King; type = PieceType(type + 1) ) {
+            Bitboard pieces = pos.pieces(color, type);
+            foreach_pop_lsb(sq, pieces)
+                features[count++] = feature_index(perspective, ksq, color, type, sq);
+        }
+    }
+
+    apply_features(gNetwork.ftBias, acc.values[perspective], features, count, nullptr, 0);
+    acc.kingSquare[perspective] = ksq;
+}
+
+/*-- Computes to from from, to is the accumulator of pos and may be the same as from --*/
+static void update(const Accumulator& from, Accumulator& to, const Position& pos) {
+    Bitboard gone[COLOR_CNT][TYPE_CNT];
+    Bitboard came[COLOR_CNT][TYPE_CNT];
+    int changed = 0;
+
+    for ( PieceColor color : { White, Black } ) {
+        for ( PieceType type = Pawn; type < King; type = PieceType(type + 1) ) {
+            const Bitboard before = from.pieces[color][type];
+            const Bitboard after  = pos.pieces(color, type);
+            gone[color][type] = before & ~after;
+            came[color][type] = after & ~before;
+            changed += popcount_bb(gone[color][type] | came[color][type]);
+        }
+    }
+
+    // values of another network can't be updated with the weights of this one
+    const bool stale = from.generation != gNetwork.generation();
+
+    for ( PieceColor perspective : { White, Black } ) {
+        const Square ksq = lsb_bb(pos.pieces(perspective, King));
+
+        // a king move changes all the inputs of its side
+        if ( stale || ksq != from.kingSquare[perspective] || changed > REFRESH_THRESHOLD ) {
+            refresh(to, pos, perspective);
+            continue;
+        }
+
+        int added[REFRESH_THRESHOLD], removed[REFRESH_THRESHOLD];
+        int addedCnt = 0, removedCnt = 0;
+
+        for ( PieceColor color : { White, Black } ) {
+            for ( PieceType type = Pawn; type < King; type = PieceType(type + 1) ) {
+                Bitboard bb = gone[color][type];
+                foreach_pop_lsb(sq, bb)
+                    removed[removedCnt++] = feature_index(perspective, ksq, color, type, sq);
+                bb = came[color][type];
+                foreach_pop_lsb(sq, bb)
+                    added[addedCnt++] = feature_index(perspective, ksq, color, type, sq);
+            }
+        }
+
+        apply_features(from.values[perspective], to.values[perspective], added, addedCnt, removed, removedCnt);
+        to.kingSquare[perspective] = ksq;
+    }
+
+    for ( PieceColor color : { White, Black } )
+        for ( PieceType type = Pawn; type < TYPE_CNT; type = PieceType(type + 1) )
+            to.pieces[color][type] = pos.pieces(color, type);
+    to.generation = gNetwork.generation();
+}
+
+AccumulatorStack::AccumulatorStack() : stack(1) {
+    stack.reserve(256);
+    Accumulator& root = stack.front();
+    std::memset(root.pieces, 0, sizeof(root.pieces));
+    root.kingSquare[White] = root.kingSquare[Black] = SQUARE_CNT;
+    root.generation = gNetwork.generation();
+}
+
+void AccumulatorStack::push(const Position& pos) {
+    stack.emplace_back();
+    update(stack[stack.size() - 2], stack.back(), pos);
+}
+
+void AccumulatorStack::reserve(std::size_t plies) {
+    stack.reserve(stack.size() + plies);
+}
+
+void AccumulatorStack::clear() {
+    // the root keeps its values, the next sync updates them from its pieces
+    stack.resize(1);
+}
+
+void AccumulatorStack::pop() {
+    // the root always stays on the stack
+    if ( stack.size() > 1 )
+        stack.pop_back();
+}
+
+const Accumulator& AccumulatorStack::sync(const Position& pos) {
+    update(stack.back(), stack.back(), pos);
+    return stack.back();
+}
+
+AccumulatorStack& accumulators() {
+    thread_local AccumulatorStack stack;
+    return stack;
+}
+
+/*-------------------
+ -- Forward pass --
+ ------------------*/
+
+Score propagate_scalar(const Accumulator& acc, PieceColor stm) {
+    std::uint8_t input[2 * HALF_DIMS];
+
+    // the side to move comes first
+    const PieceColor order[COLOR_CNT] = { stm, !stm };
+    for ( int k = 0; k < COLOR_CNT; k++ )
+        for ( int j = 0; j < HALF_DIMS; j++ )
+            input[k * HALF_DIMS + j] = std::uint8_t(std::clamp<int>(acc.values[order[k]][j], 0, ACTIVATION_MAX));
+
+    std::int32_t output = *gNetwork.outputBias;
+    for ( int o = 0; o < HIDDEN_DIMS; o++ ) {
+        const std::int8_t* row = gNetwork.hiddenWeights + o * 2 * HALF_DIMS;
+        std::int32_t sum = gNetwork.hiddenBias[o];
+        for ( int i = 0; i < 2 * HALF_DIMS; i++ )
+            sum += input[i] * row[i];
+
+        output += std::clamp(sum >> WEIGHT_SCALE_BITS, 0, ACTIVATION_MAX) * gNetwork.outputWeights[o];
+    }
+
+    return output / OUTPUT_SCALE;
+}
+
+Score propagate(const Accumulator& acc, PieceColor stm) {
+#ifdef USE_SIMD
+    constexpr int LANES_16 = sizeof(vec_t) / sizeof(std::int16_t);
+    constexpr int LANES_8  = sizeof(vec_t) / sizeof(std::int8_t);
+
+    alignas(64) std::uint8_t input[2 * HALF_DIMS];
+
+    // clipped ReLU, packing saturates to [-128, 127] and the max cuts the negative part
+    const PieceColor order[COLOR_CNT] = { stm, !stm };
+    for ( int k = 0; k < COLOR_CNT; k++ ) {
+        const vec_t* in = reinterpret_cast<const vec_t*>(acc.values[order[k]]);
+        vec_t* out = reinterpret_cast<vec_t*>(input + k * HALF_DIMS);
+        for ( int j = 0; j < HALF_DIMS / LANES_8; j++ ) {
+            vec_t packed = vec_packs_16(vec_load(in + 2 * j), vec_load(in + 2 * j + 1));
+            vec_store(out + j, vec_max_8(packed, vec_zero()));
+        }
+    }
+    static_assert(HALF_DIMS % LANES_8 == 0 && LANES_8 == 2 * LANES_16, "");
+
+    // the products of two adjacent inputs fit into int16: 2 * 127 * 128 < 2^15
+    const vec_t ones = vec_set1_16(1);
+    const vec_t* in = reinterpret_cast<const vec_t*>(input);
+
+    std::int32_t output = *gNetwork.outputBias;
+    for ( int o = 0; o < HIDDEN_DIMS; o++ ) {
+        const vec_t* row = reinterpret_cast<const vec_t*>(gNetwork.hiddenWeights + o * 2 * HALF_DIMS);
+        vec_t sum = vec_zero();
+        for ( int i = 0; i < 2 * HALF_DIMS / LANES_8; i++ )
+            sum = vec_add_32(sum, vec_madd_16(vec_maddubs(vec_load(in + i), vec_loadu(row + i)), ones));
+
+        const std::int32_t hidden = gNetwork.hiddenBias[o] + vec_hsum_32(sum);
+        output += std::clamp(hidden >> WEIGHT_SCALE_BITS, 0, ACTIVATION_MAX) * gNetwork.outputWeights[o];
+    }
+
+    return output / OUTPUT_SCALE;
+#else
+    return propagate_scalar(acc, stm);
+#endif
+}
+
+Score evaluate(const Position& pos) {
+    return propagate(accumulators().sync(pos), pos.stm());
+}
+
+} // namespace nnue
@@ -0,0 +1,155 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "types.h"
+#include "bitboard.h"
+#include "position.h"
+
+#include <string>
+#include <vector>
+
+/*---------------------------------------
+ -- Efficiently updatable neural network --
+ ---------------------------------------*/
+
+/* --
+-- HalfKP network: (64 king squares x 641 piece-squares) -> 2x256 -> 32 -> 1
+-- Each side has its own accumulator of the first layer, it is indexed by the position of the side's king
+-- and the non-king pieces of both colors as seen from that side. Moves change only a few inputs,
+-- so the accumulators are updated from the parent position instead of being recomputed.
+--
+-- File layout (little endian, every section starts at a multiple of 64 bytes):
+--      FileHeader                                      64 bytes
+--      int16 transformer bias      [HALF_DIMS]
+--      int16 transformer weights   [INPUT_DIMS][HALF_DIMS]
+--      int32 hidden bias           [HIDDEN_DIMS]
+--      int8  hidden weights        [HIDDEN_DIMS][2*HALF_DIMS]
+--      int32 output bias
+--      int8  output weights        [HIDDEN_DIMS]
+-- */
+namespace nnue {
+
+constexpr int PIECE_SQUARES = 10 * SQUARE_CNT + 1;    // 5 piece types of 2 colors on 64 squares, index 0 is unused
+constexpr int INPUT_DIMS    = SQUARE_CNT * PIECE_SQUARES;
+constexpr int HALF_DIMS     = 256;
+constexpr int HIDDEN_DIMS   = 32;
+
+constexpr int ACTIVATION_MAX    = 127;  // clipped ReLU upper bound of the quantized activations
+constexpr int WEIGHT_SCALE_BITS = 6;    // hidden layer sums are shifted back by this before clipping
+constexpr int OUTPUT_SCALE      = 16;   // network output units per centipawn
+
+constexpr std::uint32_t FILE_VERSION = 1;
+constexpr const char*   DEFAULT_FILE = "network.nnue";   // loaded at startup if present in the working directory
+
+struct FileHeader {
+    char          magic[8];             // "CEBBNNUE"
+    std::uint32_t version;
+    std::uint32_t inputDims;
+    std::uint32_t halfDims;
+    std::uint32_t hiddenDims;
+    std::uint32_t reserved[10];
+};
+static_assert(sizeof(FileHeader) == 64, "the network sections have to stay 64 byte aligned");
+
+constexpr std::size_t FILE_SIZE =
+    sizeof(FileHeader) +
+    sizeof(std::int16_t) * HALF_DIMS +
+    sizeof(std::int16_t) * std::size_t(INPUT_DIMS) * HALF_DIMS +
+    sizeof(std::int32_t) * HIDDEN_DIMS +
+    sizeof(std::int8_t)  * HIDDEN_DIMS * 2 * HALF_DIMS +
+    sizeof(std::int32_t) +
+    sizeof(std::int8_t)  * HIDDEN_DIMS;
+
+/*-- Weights of the network, the file is memory mapped and the weights are read in place --*/
+class Network {
+    void*         mapping = nullptr;
+    std::size_t   mappingSize = 0;
+    std::string   filePath;
+    std::uint32_t loadCount = 0;        // changes with every load and unload
+
+public:
+    const std::int16_t* ftBias = nullptr;
+    const std::int16_t* ftWeights = nullptr;
+    const std::int32_t* hiddenBias = nullptr;
+    const std::int8_t*  hiddenWeights = nullptr;
+    const std::int32_t* outputBias = nullptr;
+    const std::int8_t*  outputWeights = nullptr;
+
+    Network() = default;
+    Network(const Network&) = delete;
+    Network& operator=(const Network&) = delete;
+    ~Network() { unload(); }
+
+    /*-- Maps the network file, returns false and keeps the handcrafted evaluation if the file is missing or invalid --*/
+    bool load(const std::string& path);
+    void unload();
+
+    inline bool loaded() const { return mapping != nullptr; }
+
+    // Path of the loaded network, empty if none is loaded
+    inline const std::string& path() const { return filePath; }
+
+    // Accumulators of an older generation were computed with other weights
+    inline std::uint32_t generation() const { return loadCount; }
+};
+
+extern Network gNetwork;
+
+// True if evaluate() uses the network
+inline bool active() { return gNetwork.loaded(); }
+
+// Index of the input of a piece of color pc and type pt at square sq, as seen from perspective with its king at ksq
+inline int feature_index(PieceColor perspective, Square ksq, PieceColor pc, PieceType pt, Square sq) {
+    // the black side sees the board flipped vertically
+    const int flip = perspective == White ? 0 : 56;
+    const int piece = 2 * (pt - Pawn) + (pc != perspective);
+    return (ksq ^ flip) * PIECE_SQUARES + 1 + piece * SQUARE_CNT + (sq ^ flip);
+}
+
+/*-- First layer outputs of both sides, with the pieces they were computed for --*/
+struct alignas(64) Accumulator {
+    std::int16_t values[COLOR_CNT][HALF_DIMS];
+    Bitboard     pieces[COLOR_CNT][TYPE_CNT];  // [Empty] is unused
+    std::uint8_t kingSquare[COLOR_CNT];        // SQUARE_CNT if the side was never computed
+    std::uint32_t generation;                  // of the network the values were computed with
+};
+
+/* --
+-- Accumulators along the current line of the search, Board pushes one for every move made and pops it when undone.
+-- The top is updated by the difference of the piece sets, so any position can be pushed on any other,
+-- only the cost grows with the difference.
+-- */
+class AccumulatorStack {
+    std::vector<Accumulator> stack;
+
+public:
+    AccumulatorStack();
+
+    void push(const Position& pos);
+    void pop();
+
+    /*-- Makes room for plies more pushes without reallocating --*/
+    void reserve(std::size_t plies);
+
+    /*-- Drops everything above the root, for a new position the line of the old one isn't needed --*/
+    void clear();
+
+    /*-- Brings the top of the stack up to date with pos and returns it --*/
+    const Accumulator& sync(const Position& pos);
+
+    inline std::size_t size() const { return stack.size(); }
+};
+
+/*-- Accumulator stack of the calling thread --*/
+AccumulatorStack& accumulators();
+
+/*-- Evaluates the position from the perspective of the side to move, in centipawns --*/
+Score evaluate(const Position& pos);
+
+/*-- Forward pass of the layers after the accumulator, exposed for the tests --*/
+Score propagate(const Accumulator& acc, PieceColor stm);
+Score propagate_scalar(const Accumulator& acc, PieceColor stm);
+
+} // namespace nnue
+
+#endif // NNUE_H
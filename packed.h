@@ -0,0 +1,121 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include "types.h"
+#include "bitboard.h"
+#include "mapfile.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*---------------------
+ -- Packed positions --
+ --------------------*/
+
+/* --
+-- A position in 32 bytes, a legal position has at most 32 pieces so they fit into 16 bytes of nibbles.
+-- The occupied squares are listed from a1 to h8, the Piece code of the n-th occupied square is stored
+-- in the low nibble of pieces[n / 2] for even n and in the high nibble for odd n.
+-- */
+struct PackedPosition {
+    Bitboard     occupancy;
+    std::uint8_t pieces[16];
+    std::uint8_t flags;             // bit 0 side to move, bits 1-4 castling rights
+    std::uint8_t epSquare;          // NOT_ENPASSANT_SQ (a1) if there is none
+    std::uint8_t halfmoveClock;
+    std::uint8_t reserved[5];
+};
+static_assert(sizeof(PackedPosition) == 32, "packed positions must stay 32 bytes");
+
+/* --
+-- Files of fixed size records written as they are in memory, the n-th record starts at n * sizeof(T).
+-- Used for PackedPositions and for the records built on them, like the gensfen TrainingRecords.
+-- */
+
+/*-- Collects the records in a buffer and writes them in large blocks --*/
+template <typename T>
+class RecordWriter {
+    static constexpr std::size_t BUFFER_RECORDS = (1 << 20) / sizeof(T);
+
+    std::ofstream file;
+    std::vector<T> buffer;
+
+public:
+    RecordWriter() { buffer.reserve(BUFFER_RECORDS); }
+    ~RecordWriter() { close(); }
+
+    /*-- Creates the file or appends to it, returns false if it can't be opened --*/
+    bool open(const std::string& path, bool append = false) {
+        close();
+        file.open(path, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+        return bool(file);
+    }
+
+    void close() {
+        if ( file.is_open() ) {
+            flush();
+            file.close();
+        }
+    }
+
+    inline void write(const T& record) {
+        buffer.push_back(record);
+        if ( buffer.size() == BUFFER_RECORDS )
+            flush();
+    }
+
+    void write(const T* records, std::size_t count) {
+        for ( std::size_t i = 0; i < count; i++ )
+            write(records[i]);
+    }
+
+    void flush() {
+        file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(T));
+        file.flush();
+        buffer.clear();
+    }
+
+    inline bool good() const { return bool(file); }
+};
+
+/*-- Maps the file and reads the records in place, so the records can be accessed by their index at no cost --*/
+template <typename T>
+class RecordReader {
+    void*       mapping = nullptr;
+    std::size_t mappingSize = 0;
+
+public:
+    RecordReader() = default;
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+    ~RecordReader() { close(); }
+
+    /*-- Returns false if the file is missing, empty or isn't a whole number of records --*/
+    bool open(const std::string& path) {
+        close();
+        mapping = map_file(path, mappingSize);
+        if ( mapping && mappingSize % sizeof(T) != 0 )
+            close();
+        return mapping != nullptr;
+    }
+
+    void close() {
+        if ( mapping )
+            unmap_file(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+
+    inline std::size_t size() const { return mappingSize / sizeof(T); }
+
+    inline const T& operator[](std::size_t index) const { return begin()[index]; }
+
+    inline const T* begin() const { return static_cast<const T*>(mapping); }
+    inline const T* end() const { return begin() + size(); }
+};
+
+using PackedWriter = RecordWriter<PackedPosition>;
+using PackedReader = RecordReader<PackedPosition>;
+
+#endif // PACKED_H
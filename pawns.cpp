@@ -0,0 +1,133 @@
+#include "pawns.h"
+
+/*-- Precomputed Bitboards used by the pawn structure evaluation --*/
+Bitboard fileBB[FILE_CNT];                           // all squares of a file
+Bitboard adjacentFilesBB[FILE_CNT];                  // squares of the files next to a file
+Bitboard forwardFileBB[COLOR_CNT][SQUARE_CNT];       // squares in front of a square on its file
+Bitboard pawnAttackSpanBB[COLOR_CNT][SQUARE_CNT];    // squares in front of a square on the adjacent files
+Bitboard passedPawnMaskBB[COLOR_CNT][SQUARE_CNT];    // squares that must be free of enemy pawns for a passed pawn
+
+// The terms are also counted into features if it isn't null
+template <PieceColor Color>
+static void evaluate_pawns_for(const Position& pos, PawnEntry& entry, PawnFeatures* features = nullptr) {
+
+    constexpr PieceColor Ally = Color == White ? White : Black;
+    constexpr PieceColor Enemy = Color == White ? Black : White;
+    constexpr Direction Forward = Color == White ? North : South;
+    constexpr int Sign = Color == White ? 1 : -1;
+
+    const Bitboard allyPawns = pos.pieces(Ally, Pawn);
+    const Bitboard enemyPawns = pos.pieces(Enemy, Pawn);
+
+    Score mg = 0, eg = 0;
+    Bitboard pawns = allyPawns;
+
+    foreach_pop_lsb(sq, pawns) {
+
+        const int relativeRank = Color == White ? sq.rank() : 7 - sq.rank();
+        const bool doubled = forwardFileBB[Ally][sq] & allyPawns;
+        const bool isolated = (adjacentFilesBB[sq.file()] & allyPawns) == 0;
+
+        entry.attackSpan[Ally] |= pawnAttackSpanBB[Ally][sq];
+
+        if (doubled) {
+            mg -= DoubledPenalty[0];
+            eg -= DoubledPenalty[1];
+            if (features) features->doubled++;
+        }
+
+        if (isolated) {
+            mg -= IsolatedPenalty[0];
+            eg -= IsolatedPenalty[1];
+            if (features) features->isolated++;
+        } else {
+            // no friendly pawn behind or beside can support it, and its stop square is attacked by an enemy pawn
+            const Bitboard stopSquare = shift_bb<Forward>(SHL(1, sq));
+            const Bitboard supporters = pawnAttackSpanBB[Enemy][sq] | (adjacentFilesBB[sq.file()] & SHL(Rank1_bb, 8 * sq.rank()));
+            const bool backward = (supporters & allyPawns) == 0 && (stopSquare & entry.pawnAttacks[Enemy]);
+            if (backward) {
+                mg -= BackwardPenalty[0];
+                eg -= BackwardPenalty[1];
+                if (features) features->backward++;
+            }
+        }
+
+        // only the front pawn of a doubled pair can be passed
+        if (!doubled && (passedPawnMaskBB[Ally][sq] & enemyPawns) == 0) {
+            set_ref_bb(entry.passed[Ally], sq);
+            mg += PassedBonus[0][relativeRank];
+            eg += PassedBonus[1][relativeRank];
+            if (features) features->passed[relativeRank]++;
+        }
+    }
+
+    entry.mg += Sign * mg;
+    entry.eg += Sign * eg;
+}
+
+void PawnTable::evaluate_pawns(const Position& pos, PawnEntry& entry) {
+
+    const Bitboard whitePawns = pos.pieces(White, Pawn);
+    const Bitboard blackPawns = pos.pieces(Black, Pawn);
+
+    entry.key = pos.pawnKey();
+    entry.mg = 0;
+    entry.eg = 0;
+    entry.pawnAttacks[White] = shift_bb<NorthEast>(whitePawns) | shift_bb<NorthWest>(whitePawns);
+    entry.pawnAttacks[Black] = shift_bb<SouthEast>(blackPawns) | shift_bb<SouthWest>(blackPawns);
+    entry.attackSpan[White] = entry.attackSpan[Black] = Empty_bb;
+    entry.passed[White] = entry.passed[Black] = Empty_bb;
+
+    evaluate_pawns_for<White>(pos, entry);
+    evaluate_pawns_for<Black>(pos, entry);
+}
+
+void PawnTable::evaluate_pawns_side(const Position& pos, PieceColor color, Score& mg, Score& eg, PawnFeatures* features) {
+    // the side terms need the pawn attacks of both sides
+    PawnEntry entry;
+    evaluate_pawns(pos, entry);
+
+    entry.mg = entry.eg = 0;
+    if (color == White)
+        evaluate_pawns_for<White>(pos, entry, features);
+    else
+        evaluate_pawns_for<Black>(pos, entry, features);
+
+    const int sign = color == White ? 1 : -1;
+    mg = sign * entry.mg;
+    eg = sign * entry.eg;
+}
+
+PawnTable& pawn_table() {
+    thread_local PawnTable table;
+    return table;
+}
+
+/*-- singleton to initialize bitboards that are used for the pawn structure evaluation --*/
+struct GlobalsInitializerPawns {
+    GlobalsInitializerPawns() {
+
+        for (int f = 0; f < FILE_CNT; f++)
+            fileBB[f] = SHL(FileA_bb, f);
+
+        for (int f = 0; f < FILE_CNT; f++)
+            adjacentFilesBB[f] = (f > 0 ? fileBB[f - 1] : Empty_bb) | (f < FILE_CNT - 1 ? fileBB[f + 1] : Empty_bb);
+
+        for (Square sq = a1; sq < SQUARE_CNT; ++sq) {
+            Bitboard ranksAbove = Empty_bb, ranksBelow = Empty_bb;
+            for (int r = 0; r < RANK_CNT; r++) {
+                if (r > sq.rank()) ranksAbove |= SHL(Rank1_bb, 8 * r);
+                if (r < sq.rank()) ranksBelow |= SHL(Rank1_bb, 8 * r);
+            }
+
+            forwardFileBB[White][sq] = ranksAbove & fileBB[sq.file()];
+            forwardFileBB[Black][sq] = ranksBelow & fileBB[sq.file()];
+
+            pawnAttackSpanBB[White][sq] = ranksAbove & adjacentFilesBB[sq.file()];
+            pawnAttackSpanBB[Black][sq] = ranksBelow & adjacentFilesBB[sq.file()];
+
+            passedPawnMaskBB[White][sq] = forwardFileBB[White][sq] | pawnAttackSpanBB[White][sq];
+            passedPawnMaskBB[Black][sq] = forwardFileBB[Black][sq] | pawnAttackSpanBB[Black][sq];
+        }
+    }
+} const globalsInitializerPawns;
@@ -0,0 +1,90 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include "types.h"
+#include "bitboard.h"
+#include "position.h"
+
+#include <vector>
+
+/*------------------------
+ -- Pawn structure hash --
+ -----------------------*/
+
+/*-- Pawn structure weights in centipawns, middlegame and endgame --*/
+constexpr Score DoubledPenalty[2]  = { 10, 20 };
+constexpr Score IsolatedPenalty[2] = { 10, 15 };
+constexpr Score BackwardPenalty[2] = {  8, 10 };
+
+// Bonus for a passed pawn by its relative rank
+constexpr Score PassedBonus[2][RANK_CNT] = {
+    { 0,  5, 10, 15, 25, 40,  60, 0 },
+    { 0, 10, 20, 35, 55, 80, 110, 0 }
+};
+
+/*-- Number of pawns of one side scored by each pawn structure term --*/
+struct PawnFeatures {
+    int doubled = 0;
+    int isolated = 0;
+    int backward = 0;
+    int passed[RANK_CNT] = {};          // by relative rank
+};
+
+/* --
+-- Entry of the pawn hash table, keyed by the pawn zobrist key of the position
+-- Holds the pawn structure score and the bitboards derived from the pawns
+-- */
+struct PawnEntry {
+    Key      key;
+    Score    mg;                        // pawn structure score in the middlegame from White's point of view
+    Score    eg;                        // pawn structure score in the endgame from White's point of view
+    Bitboard pawnAttacks[COLOR_CNT];    // squares attacked by the pawns of each side
+    Bitboard attackSpan[COLOR_CNT];     // squares the pawns of each side can attack while advancing
+    Bitboard passed[COLOR_CNT];         // passed pawns of each side
+};
+
+/* --
+-- Pawn structure changes rarely between the nodes of the search, so the
+-- score is computed only when the pawn key of the position isn't cached
+-- */
+class PawnTable {
+    static constexpr std::size_t SIZE = 1 << 14;    // number of entries, a power of two
+
+    std::vector<PawnEntry> table;
+
+public:
+    std::uint64_t probes = 0;
+    std::uint64_t hits = 0;
+
+    PawnTable() : table(SIZE) {
+        clear();
+    }
+
+    inline void clear() {
+        // no position has this key, an empty table never hits
+        for (PawnEntry& entry : table)
+            entry.key = ~Key(0);
+    }
+
+    /*-- Returns the entry of the position, computes the pawn structure on a miss --*/
+    inline const PawnEntry* probe(const Position& pos) {
+        PawnEntry* entry = &table[pos.pawnKey() & (SIZE - 1)];
+        probes++;
+        if (entry->key == pos.pawnKey()) {
+            hits++;
+            return entry;
+        }
+        evaluate_pawns(pos, *entry);
+        return entry;
+    }
+
+    static void evaluate_pawns(const Position& pos, PawnEntry& entry);
+
+    /*-- Pawn structure score of one side from its own point of view, for the evaluation trace and the tuner --*/
+    static void evaluate_pawns_side(const Position& pos, PieceColor color, Score& mg, Score& eg, PawnFeatures* features = nullptr);
+};
+
+/*-- Pawn hash table of the calling thread --*/
+PawnTable& pawn_table();
+
+#endif
@@ -0,0 +1,186 @@
+#include "perfcounters.h"
+
+#include <cstring>
+#include <iomanip>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+bool gPerfCounters = false;
+
+static const char* const PerfEventNames[PERF_EVENT_CNT] = {
+    "cycles", "instructions", "branch-misses", "l1d-misses", "llc-misses", "dtlb-misses"
+};
+
+#ifdef __linux__
+
+// sets the type and config of the events in PerfEvent order
+static void perf_event_config(int event, perf_event_attr& attr) {
+    auto cache = [](__u64 id) {
+        return id | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+    __u32& type = attr.type;
+    __u64& config = attr.config;
+
+    switch (event) {
+    case PerfCycles:        type = PERF_TYPE_HARDWARE;  config = PERF_COUNT_HW_CPU_CYCLES; break;
+    case PerfInstructions:  type = PERF_TYPE_HARDWARE;  config = PERF_COUNT_HW_INSTRUCTIONS; break;
+    case PerfBranchMisses:  type = PERF_TYPE_HARDWARE;  config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    case PerfL1dMisses:     type = PERF_TYPE_HW_CACHE;  config = cache(PERF_COUNT_HW_CACHE_L1D); break;
+    case PerfLlcMisses:     type = PERF_TYPE_HW_CACHE;  config = cache(PERF_COUNT_HW_CACHE_LL); break;
+    case PerfDtlbMisses:    type = PERF_TYPE_HW_CACHE;  config = cache(PERF_COUNT_HW_CACHE_DTLB); break;
+    }
+}
+
+PerfCounters::PerfCounters() {
+    for (int& fd : fds)
+        fd = -1;
+}
+
+PerfCounters::~PerfCounters() {
+    close();
+}
+
+bool PerfCounters::open(std::string& error) {
+    close();
+
+    int opened = 0;
+    for (int event = 0; event < PERF_EVENT_CNT; event++) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        perf_event_config(event, attr);
+        attr.disabled = 1;
+        attr.inherit = 1;           // the threads started later are counted as well
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds[event] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fds[event] >= 0)
+            opened++;
+        else if (error.empty())
+            error = std::strerror(errno);
+    }
+
+    if (!opened)
+        return false;
+
+    error.clear();
+    return true;
+}
+
+void PerfCounters::close() {
+    for (int& fd : fds) {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+}
+
+void PerfCounters::start() {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+PerfSample PerfCounters::stop() {
+    PerfSample sample;
+
+    for (int event = 0; event < PERF_EVENT_CNT; event++) {
+        if (fds[event] < 0)
+            continue;
+
+        ioctl(fds[event], PERF_EVENT_IOC_DISABLE, 0);
+
+        // value, time enabled, time running
+        std::uint64_t data[3];
+        if (read(fds[event], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+            continue;
+
+        sample.value[event] = data[2] < data[1] ? std::uint64_t(double(data[0]) * data[1] / data[2]) : data[0];
+        sample.valid[event] = true;
+    }
+
+    return sample;
+}
+
+#else // !__linux__
+
+PerfCounters::PerfCounters() {
+    for (int& fd : fds)
+        fd = -1;
+}
+
+PerfCounters::~PerfCounters() {}
+
+bool PerfCounters::open(std::string& error) {
+    error = "perf_event_open is available on Linux only";
+    return false;
+}
+
+void PerfCounters::close() {}
+
+void PerfCounters::start() {}
+
+PerfSample PerfCounters::stop() {
+    return PerfSample();
+}
+
+#endif // __linux__
+
+std::ostream& print_perf_sample(const PerfSample& sample, std::uint64_t nodes, std::ostream& os) {
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+
+    os << "info string perf";
+    for (int event = 0; event < PERF_EVENT_CNT; event++) {
+        os << " " << PerfEventNames[event] << " ";
+        if (sample.valid[event]) os << sample.value[event]; else os << "n/a";
+    }
+    os << " ipc " << std::fixed << std::setprecision(2);
+    if (sample.valid[PerfCycles] && sample.valid[PerfInstructions] && sample.value[PerfCycles])
+        os << double(sample.value[PerfInstructions]) / sample.value[PerfCycles];
+    else
+        os << "n/a";
+    os << std::endl;
+
+    os << "info string perf per-node nodes " << nodes;
+    for (int event = 0; event < PERF_EVENT_CNT; event++) {
+        os << " " << PerfEventNames[event] << " ";
+        if (sample.valid[event] && nodes) os << double(sample.value[event]) / nodes; else os << "n/a";
+    }
+    os << std::endl;
+
+    os.flags(flags);
+    os.precision(precision);
+    return os;
+}
+
+PerfScope::PerfScope() {
+    if (!gPerfCounters)
+        return;
+
+    std::string error;
+    counting = counters.open(error);
+    if (counting)
+        counters.start();
+    else
+        std::cout << "info string perf counters unavailable: " << error << std::endl;
+}
+
+void PerfScope::report(std::uint64_t nodes, std::ostream& os) {
+    if (!counting)
+        return;
+
+    print_perf_sample(counters.stop(), nodes, os);
+    counting = false;
+}
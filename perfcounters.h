@@ -0,0 +1,72 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+/*------------------------------------
+ -- Hardware performance counters --
+ -----------------------------------*/
+
+/* --
+-- Counts hardware events of the calling thread and of the threads it starts with perf_event_open on Linux,
+-- the user space part only. Elsewhere, or if the kernel doesn't allow it (perf_event_paranoid, containers),
+-- open() fails and nothing is counted. The events which the CPU doesn't have are reported as n/a.
+-- */
+enum PerfEvent {
+    PerfCycles,
+    PerfInstructions,
+    PerfBranchMisses,
+    PerfL1dMisses,
+    PerfLlcMisses,
+    PerfDtlbMisses,
+    PERF_EVENT_CNT
+};
+
+struct PerfSample {
+    std::uint64_t value[PERF_EVENT_CNT] = {};
+    bool          valid[PERF_EVENT_CNT] = {};
+};
+
+class PerfCounters {
+    int fds[PERF_EVENT_CNT];
+
+public:
+    PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    ~PerfCounters();
+
+    /*-- Opens the counters, returns false with the reason if none of them can be counted --*/
+    bool open(std::string& error);
+    void close();
+
+    /*-- Resets and starts the counters --*/
+    void start();
+
+    /*-- Stops the counters and reads them, scaled up if the kernel multiplexed them --*/
+    PerfSample stop();
+};
+
+// Wrap the searches, perft and bench with the counters, set by the PerfCounters UCI option
+extern bool gPerfCounters;
+
+/*-- Prints the totals and the counts per node as info strings --*/
+std::ostream& print_perf_sample(const PerfSample& sample, std::uint64_t nodes, std::ostream& os = std::cout);
+
+/* --
+-- Counts from its construction to report() if gPerfCounters is set, otherwise does nothing,
+-- a failure to open the counters is reported once per scope
+-- */
+class PerfScope {
+    PerfCounters counters;
+    bool         counting = false;
+
+public:
+    PerfScope();
+
+    void report(std::uint64_t nodes, std::ostream& os = std::cout);
+};
+
+#endif // PERFCOUNTERS_H
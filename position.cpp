@@ -1,6 +1,7 @@
 #include "position.h"
 #include "movegen.h"
-#include <cstring> // memset()
+#include <cstring> // memset(), strchr()
+#include <algorithm> // std::min
 
 /*-- Precomputed Bitboards used as shortcuts during move generation --*/
 Bitboard pawnCaptureStepsBB[COLOR_CNT][SQUARE_CNT];
@@ -19,18 +20,223 @@ Key Zobrist::enpassant[FILE_CNT];
 Position::Position()
 {
     side = White;
-    occupied_bb = Empty_bb;
+    std::memset(type_bb,    0, sizeof(type_bb) );
     std::memset(colored_bb, 0, sizeof(colored_bb) );
-    std::memset(pieces_bb,  0, sizeof(pieces_bb) );
     std::memset(piece_at,    0, sizeof(piece_at) );
 
     state.castle_rights = NoCastlingFlags;
     state.epSquare = Square(a1);    // a1 == no En passant
     state.halfmove_clock = 0;
+    state.phase = 0;
+    state.material[White] = 0;
+    state.material[Black] = 0;
+    state.psqt_mg = 0;
+    state.psqt_eg = 0;
+    state.hash = 0;
+    state.pawn_key = 0;
+    state.material_key = 0;
 }
 
 void Position::movesForSide(PieceColor color, MoveList &moveList)
 {
     Position& pos = *this;
     generate_all_moves(pos, moveList);
-}
\ No newline at end of file
+}
+
+const char* fen_error_string(FenError error)
+{
+    switch (error) {
+    case FenOk:             return "ok";
+    case FenBadPlacement:   return "invalid piece placement";
+    case FenBadKings:       return "invalid kings or pawns";
+    case FenBadSide:        return "invalid side to move";
+    case FenBadCastling:    return "invalid castling rights";
+    case FenBadEnPassant:   return "invalid en passant square";
+    case FenBadClock:       return "invalid move counter";
+    case FenTrailing:       return "unexpected characters after the move counters";
+    }
+    return "unknown error";
+}
+
+FenResult Position::parseFEN(std::string_view fen)
+{
+    static constexpr char PieceNames[] = "pnbrqk";
+
+    *this = Position();
+
+    std::size_t i = 0;
+    const std::size_t size = fen.size();
+
+    auto fail = [&i](FenError error) { return FenResult{ error, std::uint16_t(i) }; };
+    auto skip_spaces = [&]() { while (i < size && (fen[i] == ' ' || fen[i] == '\t')) i++; };
+    auto field_end = [&]() { return i == size || fen[i] == ' ' || fen[i] == '\t'; };
+
+    /* piece placement from a8 to h1 */
+    skip_spaces();
+    int rank = 7;
+    int file = 0;
+    for (; !field_end(); i++) {
+        const char ch = fen[i];
+        if (ch == '/') {
+            if (file != FILE_CNT || rank == 0)
+                return fail(FenBadPlacement);
+            rank--;
+            file = 0;
+        } else if (ch >= '1' && ch <= '8') {
+            file += ch - '0';
+            if (file > FILE_CNT)
+                return fail(FenBadPlacement);
+        } else {
+            const char lower = ch | 0x20;
+            const char* name = lower >= 'a' && lower <= 'z' ? std::strchr(PieceNames, lower) : nullptr;
+            if (!name || file >= FILE_CNT)
+                return fail(FenBadPlacement);
+            setPiece(ch == lower ? Black : White, PieceType(Pawn + (name - PieceNames)), Square(file, rank));
+            file++;
+        }
+    }
+
+    if (rank != 0 || file != FILE_CNT)
+        return fail(FenBadPlacement);
+
+    if (popcount_bb(pieces(White, King)) != 1 || popcount_bb(pieces(Black, King)) != 1
+        || (pieces(Pawn) & (Rank1_bb | Rank8_bb)))
+        return fail(FenBadKings);
+
+    /* active color */
+    skip_spaces();
+    if (i < size) {
+        if (fen[i] != 'w' && fen[i] != 'b')
+            return fail(FenBadSide);
+        side = fen[i++] == 'b' ? Black : White;
+        if (!field_end())
+            return fail(FenBadSide);
+    }
+
+    /* castling rights */
+    skip_spaces();
+    if (i < size && fen[i] == '-') {
+        i++;
+    } else {
+        for (; !field_end(); i++) {
+            std::uint8_t flag;
+            switch (fen[i]) {
+            case 'K': flag = CastlingFlagWK; break;
+            case 'Q': flag = CastlingFlagWQ; break;
+            case 'k': flag = CastlingFlagBK; break;
+            case 'q': flag = CastlingFlagBQ; break;
+            default:  return fail(FenBadCastling);
+            }
+            if (state.castle_rights & flag)
+                return fail(FenBadCastling);
+            state.castle_rights |= flag;
+        }
+    }
+    if (!field_end())
+        return fail(FenBadCastling);
+
+    /* en passant square, behind a pawn of the side that just moved */
+    skip_spaces();
+    if (i < size && fen[i] == '-') {
+        i++;
+    } else if (i < size) {
+        const char epRank = side == White ? '6' : '3';
+        if (i + 1 >= size || fen[i] < 'a' || fen[i] > 'h' || fen[i + 1] != epRank)
+            return fail(FenBadEnPassant);
+        state.epSquare = Square(fen[i] - 'a', epRank - '1');
+        i += 2;
+    }
+    if (!field_end())
+        return fail(FenBadEnPassant);
+
+    /* halfmove clock, saturated to its 8 bits, and the fullmove number which isn't kept */
+    for (int counter = 0; counter < 2; counter++) {
+        skip_spaces();
+        if (i == size)
+            break;
+
+        unsigned value = 0;
+        for (; !field_end(); i++) {
+            if (fen[i] < '0' || fen[i] > '9')
+                return fail(FenBadClock);
+            value = std::min(value * 10 + (fen[i] - '0'), 255u);
+        }
+        if (counter == 0)
+            state.halfmove_clock = std::uint8_t(value);
+    }
+
+    skip_spaces();
+    if (i != size)
+        return fail(FenTrailing);
+
+    /* the pieces are already in the hash */
+    if (side == Black)
+        state.hash ^= Zobrist::black_to_move;
+    state.hash ^= Zobrist::castling[state.castle_rights];
+    if (state.epSquare != NOT_ENPASSANT)
+        state.hash ^= Zobrist::enpassant[state.epSquare.file()];
+
+    return FenResult{ FenOk, std::uint16_t(i) };
+}
+
+std::size_t Position::formatFEN(char* buf) const
+{
+    static constexpr char PieceNames[COLOR_CNT][TYPE_CNT + 1] = { " PNBRQK", " pnbrqk" };
+
+    char* out = buf;
+
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < FILE_CNT; file++) {
+            const Piece piece = pieceAt(Square(file, rank));
+            if (piece.isEmpty()) {
+                empty++;
+                continue;
+            }
+            if (empty)
+                *out++ = char('0' + empty);
+            empty = 0;
+            *out++ = PieceNames[piece.color()][piece.type()];
+        }
+        if (empty)
+            *out++ = char('0' + empty);
+        if (rank)
+            *out++ = '/';
+    }
+
+    *out++ = ' ';
+    *out++ = side == White ? 'w' : 'b';
+    *out++ = ' ';
+
+    if (state.castle_rights == NoCastlingFlags) {
+        *out++ = '-';
+    } else {
+        if (state.castle_rights & CastlingFlagWK) *out++ = 'K';
+        if (state.castle_rights & CastlingFlagWQ) *out++ = 'Q';
+        if (state.castle_rights & CastlingFlagBK) *out++ = 'k';
+        if (state.castle_rights & CastlingFlagBQ) *out++ = 'q';
+    }
+    *out++ = ' ';
+
+    if (state.epSquare != NOT_ENPASSANT_SQ) {
+        *out++ = char('a' + state.epSquare.file());
+        *out++ = char('1' + state.epSquare.rank());
+    } else {
+        *out++ = '-';
+    }
+    *out++ = ' ';
+
+    const unsigned clock = state.halfmove_clock;
+    if (clock >= 100)
+        *out++ = char('0' + clock / 100);
+    if (clock >= 10)
+        *out++ = char('0' + clock / 10 % 10);
+    *out++ = char('0' + clock % 10);
+
+    // the fullmove number isn't kept
+    *out++ = ' ';
+    *out++ = '0';
+    *out = '\0';
+
+    return std::size_t(out - buf);
+}
@@ -4,8 +4,10 @@
 #include "types.h"
 #include "bitboard.h"
 #include "zobrist.h"
+#include "psqt.h"
 
 #include <iostream>
+#include <string_view>
 
 enum CastlingRights : std::uint8_t {
     NoCastlingFlags = 0,
@@ -15,6 +17,15 @@ enum CastlingRights : std::uint8_t {
     CastlingFlagBK = SHL(1,3)
 };
 
+/*-- Material key, the count of each piece type of each side packed in 4 bits, kings aren't counted --*/
+constexpr Key materialKeyIncrement(PieceColor color, PieceType type) {
+    return (type == Empty || type == King) ? 0 : SHL(1, 4 * (color * 5 + type - Pawn));
+}
+
+constexpr int materialCount(Key materialKey, PieceColor color, PieceType type) {
+    return (type == Empty || type == King) ? 0 : SHR(materialKey, 4 * (color * 5 + type - Pawn)) & 0x0F;
+}
+
 const Square NOT_ENPASSANT(a1); // invalid En Passant square
 const Square NOT_ENPASSANT_SQ(a1); // invalid En Passant square
 
@@ -22,17 +33,50 @@ struct PositionState {
     std::uint8_t castle_rights;
     Square epSquare;                // En Passant square, a1 == invalid
     std::uint8_t halfmove_clock;    // half move clock;
+    std::uint8_t phase;             // game phase, sum of PhaseWeight of the pieces on the board
+    std::int16_t material[COLOR_CNT];   // sum of PieceWeight for each side
+    std::int16_t psqt_mg;           // middlegame piece-square sum from White's point of view
+    std::int16_t psqt_eg;           // endgame piece-square sum from White's point of view
     Key hash;                       // zobrist hash
+    Key pawn_key;                   // zobrist hash of the pawns only
+    Key material_key;               // piece counts, see materialKeyIncrement()
+};
+
+/*-- Errors of the FEN parser, the FenResult points at the offending character --*/
+enum FenError : std::uint8_t {
+    FenOk = 0,
+    FenBadPlacement,    // not 8 ranks of 8 files or an unknown piece
+    FenBadKings,        // not exactly one king per side or a pawn on the first or last rank
+    FenBadSide,
+    FenBadCastling,
+    FenBadEnPassant,
+    FenBadClock,
+    FenTrailing         // something follows the move counters
+};
+
+struct FenResult {
+    FenError      error;
+    std::uint16_t offset;   // index into the FEN where parsing stopped
+
+    explicit operator bool() const { return error == FenOk; }
 };
 
+const char* fen_error_string(FenError error);
+
+/*-- Size of a buffer that holds any FEN written by Position::formatFEN, with the terminating zero --*/
+constexpr std::size_t FEN_BUFFER_SIZE = 96;
+
 class MoveList;
 
-class Position
+/* --
+-- The position is laid out in cache lines, the bitboards share the first line,
+-- the mailbox the second one and the state the third one, 192 bytes in total
+-- */
+class alignas(64) Position
 {
 protected:
-    Bitboard occupied_bb;
+    Bitboard type_bb[TYPE_CNT - Pawn];  // pieces of both colors by type, indexed from Pawn
     Bitboard colored_bb[COLOR_CNT];
-    Bitboard pieces_bb[COLOR_CNT][TYPE_CNT];
 
     Piece  piece_at[SQUARE_CNT];
 
@@ -50,15 +94,30 @@ public:
     inline void setPiece(Piece piece, Square square);
     inline void setPiece(PieceColor color, PieceType type, Square square);
     inline void removePiece(Square square);    
+    inline void movePiece(Square origin, Square target);
+
+    // Applies a legal move to the position, no undo information is kept (copy-make)
+    inline void apply(Move move);
 
-    inline Bitboard occupied() const { return occupied_bb; }
+    template <PieceColor Color>
+    inline void apply(Move move);
+
+    inline Bitboard occupied() const { return colored_bb[White] | colored_bb[Black]; }
     inline Bitboard colored(PieceColor withColor)            const { return colored_bb[withColor]; }
-    inline Bitboard pieces(PieceColor color, PieceType type) const { return pieces_bb[color][type]; }
+    inline Bitboard pieces(PieceType type)                   const { assert(type != Empty); return type_bb[type - Pawn]; }
+    inline Bitboard pieces(PieceColor color, PieceType type) const { return pieces(type) & colored_bb[color]; }
 
     inline Square enPassantSq() const { return state.epSquare; }
     inline std::uint8_t castling() const { return state.castle_rights; }
     std::uint8_t halfmove_clock() const { return state.halfmove_clock; }
     Key hash() const { return state.hash; }
+    Key pawnKey() const { return state.pawn_key; }
+    Key materialKey() const { return state.material_key; }
+
+    inline Score material(PieceColor color) const { return state.material[color]; }
+    inline int phase() const { return state.phase; }
+    inline Score psqtMg() const { return state.psqt_mg; }
+    inline Score psqtEg() const { return state.psqt_eg; }
     
     inline Bitboard pinned() const { return pinned_bb; }
     inline void setPinned(Bitboard newPinned) { pinned_bb = newPinned; }
@@ -77,6 +136,15 @@ public:
     //bool isOccupied(Square square) const { return is_set_bb(occupied_bb, square); }
 
     void movesForSide(PieceColor color, MoveList& moveList);
+
+    /* --
+    -- Replaces the position by the one in the FEN without allocating, the fields after the piece placement
+    -- are optional like in EPD records and the fullmove counter is ignored. The position is undefined on error.
+    -- */
+    FenResult parseFEN(std::string_view fen);
+
+    /*-- Writes the FEN with a terminating zero into buf of FEN_BUFFER_SIZE chars, returns its length --*/
+    std::size_t formatFEN(char* buf) const;
     //void movesForPawns(PieceColor color, std::vector<Move> &moveList);
 
 private:    /* helper functions */
@@ -85,32 +153,35 @@ protected:
 
 };
 
+static_assert(sizeof(Piece) == 1, "mailbox entries must fit into a byte");
+static_assert(sizeof(Position) == 192, "Position must fit into three cache lines");
+
 inline void Position::setPiece(Piece piece, Square square)
 {
     assert(piece.type() != Empty);
+    assert(piece_at[square].type() == Empty);
 
-    const PieceColor color = piece.color();
+    const Bitboard squareBB = SHL(1, square);
 
-    set_ref_bb(occupied_bb, square);
-    set_ref_bb(colored_bb[color], square);
-    set_ref_bb(pieces_bb[color][piece.type()], square);
+    colored_bb[piece.color()] ^= squareBB;
+    type_bb[piece.type() - Pawn] ^= squareBB;
 
     piece_at[square] = piece;
 
-    state.hash ^= Zobrist::pieces[color][square][piece.type()];
+    state.hash ^= Zobrist::pieces[piece.color()][square][piece.type()];
+    if (piece.isPawn())
+        state.pawn_key ^= Zobrist::pieces[piece.color()][square][Pawn];
+
+    state.material_key += materialKeyIncrement(piece.color(), piece.type());
+    state.material[piece.color()] += PieceWeight[piece.type()];
+    state.phase   += PhaseWeight[piece.type()];
+    state.psqt_mg += PSQT::mg[piece.color()][piece.type()][square];
+    state.psqt_eg += PSQT::eg[piece.color()][piece.type()][square];
 }
 
 inline void Position::setPiece(PieceColor color, PieceType type, Square square)
 {
-    assert(type != Empty);
-
-    set_ref_bb(occupied_bb, square);
-    set_ref_bb(colored_bb[color], square);
-    set_ref_bb(pieces_bb[color][type], square);
-
-    piece_at[square] = Piece(color, type);
-
-    state.hash ^= Zobrist::pieces[color][square][type];
+    setPiece(Piece(color, type), square);
 }
 
 inline void Position::removePiece(Square square)
@@ -118,17 +189,159 @@ inline void Position::removePiece(Square square)
     assert(piece_at[square].type() != Empty);
 
     const Piece p = piece_at[square];
-    const PieceColor color = p.color();
+    const Bitboard squareBB = SHL(1, square);
 
-    reset_ref_bb(occupied_bb, square);
-    reset_ref_bb(colored_bb[color], square);
-    reset_ref_bb(pieces_bb[color][p.type()], square);
+    colored_bb[p.color()] ^= squareBB;
+    type_bb[p.type() - Pawn] ^= squareBB;
 
     piece_at[square] = Piece(White, Empty);
 
-    state.hash ^= Zobrist::pieces[color][square][p.type()];
+    state.hash ^= Zobrist::pieces[p.color()][square][p.type()];
+    if (p.isPawn())
+        state.pawn_key ^= Zobrist::pieces[p.color()][square][Pawn];
+
+    state.material_key -= materialKeyIncrement(p.color(), p.type());
+    state.material[p.color()] -= PieceWeight[p.type()];
+    state.phase   -= PhaseWeight[p.type()];
+    state.psqt_mg -= PSQT::mg[p.color()][p.type()][square];
+    state.psqt_eg -= PSQT::eg[p.color()][p.type()][square];
 }
 
+/*-- Moves a piece to an empty square, both squares are toggled with one mask --*/
+inline void Position::movePiece(Square origin, Square target)
+{
+    assert(piece_at[origin].type() != Empty);
+    assert(piece_at[target].type() == Empty);
+
+    const Piece p = piece_at[origin];
+    const Bitboard originTargetBB = SHL(1, origin) | SHL(1, target);
+
+    colored_bb[p.color()] ^= originTargetBB;
+    type_bb[p.type() - Pawn] ^= originTargetBB;
+
+    piece_at[target] = p;
+    piece_at[origin] = Piece(White, Empty);
+
+    state.hash ^= Zobrist::pieces[p.color()][origin][p.type()] ^ Zobrist::pieces[p.color()][target][p.type()];
+    if (p.isPawn())
+        state.pawn_key ^= Zobrist::pieces[p.color()][origin][Pawn] ^ Zobrist::pieces[p.color()][target][Pawn];
+
+    state.psqt_mg += PSQT::mg[p.color()][p.type()][target] - PSQT::mg[p.color()][p.type()][origin];
+    state.psqt_eg += PSQT::eg[p.color()][p.type()][target] - PSQT::eg[p.color()][p.type()][origin];
+}
+
+inline void Position::apply(Move move)
+{
+    if (side == White)
+        apply<White>(move);
+    else
+        apply<Black>(move);
+}
+
+template <PieceColor Color>
+inline void Position::apply(Move move)
+{
+    constexpr PieceColor Ally  = Color == White ? White : Black;
+
+    constexpr Square KingOrigin  = Color == White ? Square(e1) : Square(e8);
+    constexpr Square RookQSide   = Color == White ? Square(a1) : Square(a8);
+    constexpr Square RookQTarget = Color == White ? Square(d1) : Square(d8);
+    constexpr Square RookKSide   = Color == White ? Square(h1) : Square(h8);
+    constexpr Square RookKTarget = Color == White ? Square(f1) : Square(f8);
+    constexpr std::uint8_t CastleQSideFlag = Color == White ? CastlingFlagWQ : CastlingFlagBQ;
+    constexpr std::uint8_t CastleKSideFlag = Color == White ? CastlingFlagWK : CastlingFlagBK;
+
+    const Square origin = move.origin();
+    const Square target = move.target();
+    const Square behindTarget = Color == White ? target.prevRank() : target.nextRank();
+
+    assert(side == Ally);
+    assert(piece_at[origin].color() == Ally && piece_at[origin].type() != Empty);
+
+    /* handle state changes */
+
+    // Remove en passant square from the hash
+    if (state.epSquare != NOT_ENPASSANT_SQ ) {
+        state.hash ^= Zobrist::enpassant[state.epSquare.file()];
+        state.epSquare = NOT_ENPASSANT_SQ;
+    }
+
+    // handle half move clock for the fifty-move rule
+    if (move.isCapture() || piece_at[origin].isPawn()) {
+        state.halfmove_clock = 0;
+    } else {
+        ++state.halfmove_clock;
+    }
+
+    // handle castling rights, only our king and rooks can leave their origin squares
+    const std::uint8_t oldCastleRights = state.castle_rights;
+    if (origin == KingOrigin) {
+        state.castle_rights &= ~(CastleQSideFlag | CastleKSideFlag);
+    } else if (origin == RookQSide) {
+        state.castle_rights &= ~CastleQSideFlag;
+    } else if (origin == RookKSide) {
+        state.castle_rights &= ~CastleKSideFlag;
+    }
+
+    if (oldCastleRights != state.castle_rights) {
+        state.hash ^= Zobrist::castling[oldCastleRights];       // remove old castling flags
+        state.hash ^= Zobrist::castling[state.castle_rights];   // set new castling flags
+    }
+
+    /* make positional changes */
+    switch (move.type()) {
+    case QuietMove:
+        movePiece(origin, target);
+        break;
+
+    case DoublePush:
+        movePiece(origin, target);
+        state.epSquare = behindTarget;
+        state.hash ^= Zobrist::enpassant[state.epSquare.file()];
+        break;
+
+    case Capture:
+        removePiece(target);
+        movePiece(origin, target);
+        break;
+
+    case CastleKSide:
+        movePiece(origin, target);
+        movePiece(RookKSide, RookKTarget);
+        break;
+
+    case CastleQSide:
+        movePiece(origin, target);
+        movePiece(RookQSide, RookQTarget);
+        break;
+
+    case CaptureEnPas:
+        // target points to the en passant square, the captured pawn is behind it
+        assert(piece_at[behindTarget].type() == Pawn);
+        removePiece(behindTarget);
+        movePiece(origin, target);
+        break;
+
+    case PromToKnightCapture: case PromToBishopCapture:
+    case PromToRookCapture:   case PromToQueenCapture:
+        removePiece(target);
+        removePiece(origin);
+        setPiece(Ally, move.promoteTo(), target);
+        break;
+
+    case PromToKnight: case PromToBishop:
+    case PromToRook:   case PromToQueen:
+        removePiece(origin);
+        setPiece(Ally, move.promoteTo(), target);
+        break;
+
+    default:
+        assert(false); // invalid move in apply
+    }
+
+    side = !side;
+    state.hash ^= Zobrist::black_to_move;
+}
 
 
 #endif // POSITION_H
@@ -0,0 +1,36 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <iomanip>
+
+static const char* const PhaseNames[PHASE_CNT] = {
+    "movegen", "sort", "eval", "ttprobe", "ttsave", "movedo", "moveundo", "qsearch"
+};
+
+void print_phase_profile(const PhaseProfile& profile, std::ostream& os) {
+    const std::uint64_t totalTicks = std::max<std::uint64_t>(profile_ticks() - profile.startTicks, 1);
+    const double totalNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - profile.startTime).count();
+    const double nsPerTick = totalNs / totalTicks;
+
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << std::fixed;
+
+    std::uint64_t phaseTicks = 0;
+    for ( int phase = 0; phase < PHASE_CNT; phase++ ) {
+        const std::uint64_t calls = profile.calls[phase];
+        phaseTicks += profile.selfTicks[phase];
+
+        os << "info string profile " << PhaseNames[phase] << " calls " << calls
+           << " self " << std::setprecision(1) << 100.0 * profile.selfTicks[phase] / totalTicks << "%"
+           << " total " << 100.0 * profile.ticks[phase] / totalTicks << "%"
+           << " ns/call " << std::setprecision(1) << (calls ? profile.ticks[phase] * nsPerTick / calls : 0.0) << std::endl;
+    }
+
+    const std::uint64_t otherTicks = totalTicks > phaseTicks ? totalTicks - phaseTicks : 0;
+    os << "info string profile other self " << std::setprecision(1) << 100.0 * otherTicks / totalTicks << "%"
+       << " time " << std::setprecision(0) << totalNs / 1e6 << "ms" << std::endl;
+
+    os.flags(flags);
+    os.precision(precision);
+}
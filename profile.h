@@ -0,0 +1,111 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILE_RDTSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define PROFILE_RDTSC
+#endif
+
+#include "types.h"
+
+/*------------------------------
+ -- Search phase profiler --
+ -----------------------------*/
+
+/* --
+-- Scoped timers around the phases of the search, compiled in with PHASE_PROFILE (types.h).
+-- Without it PROFILED(phase, expr) is just expr, so the default build doesn't pay anything.
+-- The timers nest, the self time of a phase excludes the phases timed inside it, so qsearch
+-- is only the qsearch logic and its moves, evaluations etc. are counted in their own phases.
+-- The time is read with rdtsc where available and converted to ns against the steady clock.
+-- */
+enum SearchPhase {
+    PhaseMovegen,
+    PhaseSort,
+    PhaseEval,
+    PhaseTTProbe,
+    PhaseTTSave,
+    PhaseMoveDo,
+    PhaseMoveUndo,
+    PhaseQsearch,
+    PHASE_CNT
+};
+
+inline std::uint64_t profile_ticks() {
+#ifdef PROFILE_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class PhaseTimer;
+
+struct PhaseProfile {
+    std::uint64_t calls[PHASE_CNT] = {};
+    std::uint64_t ticks[PHASE_CNT] = {};        // including the nested phases
+    std::uint64_t selfTicks[PHASE_CNT] = {};
+
+    PhaseTimer*   current = nullptr;            // innermost running timer
+
+    // start of the profiled interval, to calibrate the ticks and to get the time outside of the phases
+    std::uint64_t startTicks = 0;
+    std::chrono::steady_clock::time_point startTime;
+
+    inline void clear() {
+        *this = PhaseProfile();
+        startTicks = profile_ticks();
+        startTime = std::chrono::steady_clock::now();
+    }
+};
+
+/*-- Phase profile of the calling thread --*/
+inline PhaseProfile& phase_profile() {
+    thread_local PhaseProfile profile;
+    return profile;
+}
+
+class PhaseTimer {
+    PhaseProfile& profile;
+    PhaseTimer*   parent;
+    SearchPhase   phase;
+    std::uint64_t start;
+    std::uint64_t childTicks = 0;
+
+public:
+    inline explicit PhaseTimer(SearchPhase phase) : profile(phase_profile()), parent(profile.current), phase(phase) {
+        profile.current = this;
+        start = profile_ticks();
+    }
+
+    inline ~PhaseTimer() {
+        const std::uint64_t elapsed = profile_ticks() - start;
+        profile.calls[phase]++;
+        profile.ticks[phase] += elapsed;
+        profile.selfTicks[phase] += elapsed - childTicks;
+        if ( parent )
+            parent->childTicks += elapsed;
+        profile.current = parent;
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+};
+
+#ifdef PHASE_PROFILE
+#define PROFILED(phase, expr) ([&]() { PhaseTimer phaseTimer_(phase); return expr; }())
+#else
+#define PROFILED(phase, expr) (expr)
+#endif
+
+/*-- Prints the share of the time since clear() and the ns per call of each phase as info strings --*/
+void print_phase_profile(const PhaseProfile& profile, std::ostream& os = std::cout);
+
+#endif // PROFILE_H
@@ -0,0 +1,101 @@
+#include "psqt.h"
+
+std::int16_t PSQT::mg[COLOR_CNT][TYPE_CNT][SQUARE_CNT];
+std::int16_t PSQT::eg[COLOR_CNT][TYPE_CNT][SQUARE_CNT];
+
+/*-- Tables as seen by White, a8 is the first entry and h1 the last one --*/
+static const std::int8_t PawnTable[SQUARE_CNT] = {
+      0,  0,  0,  0,  0,  0,  0,  0,
+     50, 50, 50, 50, 50, 50, 50, 50,
+     10, 10, 20, 30, 30, 20, 10, 10,
+      5,  5, 10, 25, 25, 10,  5,  5,
+      0,  0,  0, 20, 20,  0,  0,  0,
+      5, -5,-10,  0,  0,-10, -5,  5,
+      5, 10, 10,-20,-20, 10, 10,  5,
+      0,  0,  0,  0,  0,  0,  0,  0
+};
+
+static const std::int8_t KnightTable[SQUARE_CNT] = {
+    -50,-40,-30,-30,-30,-30,-40,-50,
+    -40,-20,  0,  0,  0,  0,-20,-40,
+    -30,  0, 10, 15, 15, 10,  0,-30,
+    -30,  5, 15, 20, 20, 15,  5,-30,
+    -30,  0, 15, 20, 20, 15,  0,-30,
+    -30,  5, 10, 15, 15, 10,  5,-30,
+    -40,-20,  0,  5,  5,  0,-20,-40,
+    -50,-40,-30,-30,-30,-30,-40,-50
+};
+
+static const std::int8_t BishopTable[SQUARE_CNT] = {
+    -20,-10,-10,-10,-10,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5, 10, 10,  5,  0,-10,
+    -10,  5,  5, 10, 10,  5,  5,-10,
+    -10,  0, 10, 10, 10, 10,  0,-10,
+    -10, 10, 10, 10, 10, 10, 10,-10,
+    -10,  5,  0,  0,  0,  0,  5,-10,
+    -20,-10,-10,-10,-10,-10,-10,-20
+};
+
+static const std::int8_t RookTable[SQUARE_CNT] = {
+      0,  0,  0,  0,  0,  0,  0,  0,
+      5, 10, 10, 10, 10, 10, 10,  5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+      0,  0,  0,  5,  5,  0,  0,  0
+};
+
+static const std::int8_t QueenTable[SQUARE_CNT] = {
+    -20,-10,-10, -5, -5,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5,  5,  5,  5,  0,-10,
+     -5,  0,  5,  5,  5,  5,  0, -5,
+      0,  0,  5,  5,  5,  5,  0, -5,
+    -10,  5,  5,  5,  5,  5,  0,-10,
+    -10,  0,  5,  0,  0,  0,  0,-10,
+    -20,-10,-10, -5, -5,-10,-10,-20
+};
+
+static const std::int8_t KingMiddlegameTable[SQUARE_CNT] = {
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -20,-30,-30,-40,-40,-30,-30,-20,
+    -10,-20,-20,-20,-20,-20,-20,-10,
+     20, 20,  0,  0,  0,  0, 20, 20,
+     20, 30, 10,  0,  0, 10, 30, 20
+};
+
+static const std::int8_t KingEndgameTable[SQUARE_CNT] = {
+    -50,-40,-30,-20,-20,-30,-40,-50,
+    -30,-20,-10,  0,  0,-10,-20,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-30,  0,  0,  0,  0,-30,-30,
+    -50,-30,-30,-30,-30,-30,-30,-50
+};
+
+/*-- Initialize the piece-square tables for both sides and both phases --*/
+void PSQT::init() {
+
+    const std::int8_t* middlegame[TYPE_CNT] = { nullptr, PawnTable, KnightTable, BishopTable, RookTable, QueenTable, KingMiddlegameTable };
+    const std::int8_t* endgame[TYPE_CNT]    = { nullptr, PawnTable, KnightTable, BishopTable, RookTable, QueenTable, KingEndgameTable };
+
+    for (int t = Pawn; t < TYPE_CNT; t++) {
+        for (Square sq = a1; sq < SQUARE_CNT; ++sq) {
+            // the tables start at a8, so a white square is flipped and a black square is the mirrored white square
+            mg[White][t][sq] =  middlegame[t][sq.flip()];
+            eg[White][t][sq] =  endgame[t][sq.flip()];
+            mg[Black][t][sq] = -middlegame[t][sq];
+            eg[Black][t][sq] = -endgame[t][sq];
+        }
+    }
+}
+
+PSQT gInitializerPSQT; // Singleton, to initialize the piece-square tables
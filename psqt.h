@@ -0,0 +1,51 @@
+#ifndef PSQT_H
+#define PSQT_H
+
+#include "types.h"
+
+/*--
+-- Piece Weights for material calucaltion in centipawns
+-- Details for weights at https://www.chessprogramming.org/Simplified_Evaluation_Function
+--*/
+const static int PieceWeight[TYPE_CNT] = {
+    0,       // Empty
+    100,     // Pawn
+    320,     // Knight,
+    330,     // Bishop,     
+    500,     // Rook, 
+    900,     // Queen
+    0,       // King
+};
+
+/*--
+-- Game phase weights, the phase is the sum over all pieces on the board
+-- and goes from GAME_PHASE_MAX (opening) down to 0 (pawns and kings only)
+--*/
+const static int PhaseWeight[TYPE_CNT] = { 0, 0, 1, 1, 2, 4, 0 };
+
+constexpr int GAME_PHASE_MAX = 24;
+
+/*--
+-- Piece-square tables for the middlegame and the endgame, from White's point of view, the sign is already applied for Black
+-- Details for the tables at https://www.chessprogramming.org/Simplified_Evaluation_Function
+--*/
+class PSQT {
+
+public:
+    static std::int16_t mg[COLOR_CNT][TYPE_CNT][SQUARE_CNT];
+    static std::int16_t eg[COLOR_CNT][TYPE_CNT][SQUARE_CNT];
+
+    void init();
+
+    PSQT() {
+        init();
+    }
+};
+
+/*-- Blends the middlegame and endgame scores by the game phase --*/
+inline Score taperedScore(Score mg, Score eg, int phase) {
+    phase = std::min(phase, GAME_PHASE_MAX);
+    return (mg * phase + eg * (GAME_PHASE_MAX - phase)) / GAME_PHASE_MAX;
+}
+
+#endif
@@ -1,15 +1,42 @@
+#include <algorithm>
 #include <utility>
 #include <tuple>
+#include <iomanip>
+#include <thread>
 
 #include "search.h"
 #include "board.h"
 #include "util.h"
 #include "engine.h"
+#include "perfcounters.h"
+#include "profile.h"
+#include "alloctrack.h"
+#include "timeman.h"
 
 #define Pair(a, b)  std::make_pair((a), (b))
 
-// global flag dictating if the search should stop
-bool gStopSearching;
+// flag dictating if the search should stop, per thread like the search limits
+thread_local bool gStopSearching;
+
+bool gSearchStats = false;
+
+int gMultiPV = 1;
+
+/* --
+-- A root move with what the iterations learned about it. The root moves are kept from one iteration to the
+-- next and ordered by their last scores, the moves without a score by the nodes their subtrees took.
+-- */
+struct RootMove {
+    Move     move;
+    Score    score;                 // of the current iteration, -CHECKMATE_SCORE if the move failed low
+    Score    prevScore;             // of the last completed iteration
+    uint64_t nodes;                 // of the subtree in the current iteration, re-searches included
+    Move     pv[MAX_PV_LENGTH];     // starts with the move, set with its score
+    int      pvLength;
+};
+
+/*-- Maximum num of root moves, as in MoveList --*/
+constexpr int MAX_ROOT_MOVES = 256;
 
 struct SearchScope {
     // Total nodes searched
@@ -22,104 +49,419 @@ struct SearchScope {
     Move bestMove;
     // Total search depth
     int depth;
-    // Hash hits during search
-    uint64_t hashHitCnt;
+    // Counters of the current iteration
+    SearchStats stats;
+    // of the completed iterations
+    std::vector<SearchStats> iterations;
     
     // start time of the search
     uint64_t start_time;
     
     // search limits
-    Time     timeLimit;
+    Time     timeLimit;             // hard, the optimum is kept by the time manager
     uint64_t nodesLimit;
     int      depthLimit;
     int srlimits;
 
-} ss;
+    // no info output, set by search_fixed()
+    bool silent;
+
+    // the moves searched at the root, best first after a completed iteration
+    RootMove rootMoves[MAX_ROOT_MOVES];
+    int      rootMoveCnt;
+    // restricts the root moves if not empty, null for the searches started by the engine itself
+    const MoveList* searchmoves;
+    // lines printed, the first root moves after an iteration, search() keeps it within the root moves
+    // lines printed, the first root moves after an iteration
+    int  multiPV;
+    // root moves of the better lines, skipped by the search of the next line
+    Move excluded[MAX_MULTIPV];
+    int  excludedCnt;
+
+    // requests of the UCI thread, null for the searches started by the engine itself
+    SearchSignals* signals;
+    // runs until stop, the time limits don't apply while pondering
+    bool infinite;
+    bool pondering;
+
+    // plans the time between the iterations
+    TimeManager timeManager;
+    // calls of alphabeta left until the clock is read again
+    int timeCheckCountdown;
+
+} thread_local ss;  // per thread, the tuner runs qsearch on all cores
+
+const std::vector<SearchStats>& search_stats() {
+    return ss.iterations;
+}
 
+static RootMove* find_root_move(Move mv) {
+    RootMove* end = ss.rootMoves + ss.rootMoveCnt;
+    RootMove* rm = std::find_if(ss.rootMoves, end, [mv](const RootMove& rm) { return rm.move == mv; });
+    return rm != end ? rm : nullptr;
+}
 
-void updateSearchLimits() {
-    
-    if ( ss.srlimits & TimeLimit ) {
-        auto now = now_time_ms();
-        gStopSearching = (now - ss.start_time) >= ss.timeLimit;
+// The legal moves in the MVV-LVA order, those of searchmoves only if it isn't empty
+static void init_root_moves(Board& b) {
+    MoveList moves;
+    generate_all_moves(b, moves);
+    sort_moves(b, 0, moves, NullMove);
+
+    ss.rootMoveCnt = 0;
+    for ( Move mv : moves ) {
+        const bool searched = !ss.searchmoves || ss.searchmoves->empty() ||
+            std::find(ss.searchmoves->begin(), ss.searchmoves->end(), mv) != ss.searchmoves->end();
+        if ( !searched )
+            continue;
+
+        RootMove& rm = ss.rootMoves[ss.rootMoveCnt++];
+        rm.move = mv;
+        rm.score = rm.prevScore = -CHECKMATE_SCORE;
+        rm.nodes = 0;
+        rm.pv[0] = mv;
+        rm.pvLength = 1;
+    }
+}
+
+static void begin_iteration_root_moves() {
+    for ( int i = 0; i < ss.rootMoveCnt; i++ ) {
+        RootMove& rm = ss.rootMoves[i];
+        rm.prevScore = rm.score;
+        rm.score = -CHECKMATE_SCORE;
+        rm.nodes = 0;
     }
+}
+
+// Orders the root moves of the completed iteration for the next one, the best move goes first
+static void end_iteration_root_moves() {
+    std::stable_sort(ss.rootMoves, ss.rootMoves + ss.rootMoveCnt, [](const RootMove& a, const RootMove& b) {
+        return a.score != b.score ? a.score > b.score : a.nodes > b.nodes;
+    });
+    if ( ss.rootMoveCnt )
+        ss.bestMove = ss.rootMoves[0].move;
+}
+
+// Part of the root nodes of the iteration taken by the best move
+static double best_move_share() {
+    uint64_t total = 0;
+    for ( int i = 0; i < ss.rootMoveCnt; i++ )
+        total += ss.rootMoves[i].nodes;
+    return total ? double(ss.rootMoves[0].nodes) / total : 0.0;
+}
+
+// Starts the counters of the iteration of the given depth
+static void begin_iteration_stats(int depth) {
+    ss.stats = SearchStats();
+    ss.stats.depth = depth;
+    ss.stats.nodes = ss.nodes;
+    ss.stats.qnodes = ss.qnodes;
+    ss.stats.evalCacheProbes = eval_cache().probes;
+    ss.stats.evalCacheHits = eval_cache().hits;
+}
+
+// Keeps the counters of the completed iteration and prints them if asked to
+static void end_iteration_stats(Score score) {
+    SearchStats& stats = ss.stats;
+    stats.score = score;
+    stats.timeMs = now_time_ms() - ss.start_time;
+    stats.nodes = ss.nodes - stats.nodes;
+    stats.qnodes = ss.qnodes - stats.qnodes;
+    stats.evalCacheProbes = eval_cache().probes - stats.evalCacheProbes;
+    stats.evalCacheHits = eval_cache().hits - stats.evalCacheHits;
+
+    const uint64_t prevNodes = ss.iterations.empty() ? 0 : ss.iterations.back().nodes;
+    ss.iterations.push_back(stats);
+
+    if ( gSearchStats && !ss.silent )
+        print_search_stats(stats, prevNodes);
+}
 
-    if ( ss.srlimits & NodesLimit ) {
-        gStopSearching = ss.nodes >= ss.nodesLimit;
+
+/*-- Reading the clock costs more than a node, it is read once per this many calls of alphabeta --*/
+constexpr int TIME_CHECK_INTERVAL = 1024;
+
+// Reads the requests of the UCI thread
+void pollSearchSignals() {
+    if ( !ss.signals )
+        return;
+
+    if ( ss.signals->stop.load(std::memory_order_relaxed) )
+        gStopSearching = true;
+
+    // the clock runs from the ponderhit, the time spent pondering is added to the budget
+    if ( ss.pondering && ss.signals->ponderhit.load(std::memory_order_relaxed) ) {
+        ss.pondering = false;
+        const Time pondered = now_time_ms() - ss.start_time;
+        ss.timeLimit += pondered;
+        ss.timeManager.extend(pondered);
     }
 }
 
-// Get the amount of time that should be allocated for the current move for the current side
-Time getSearchTime(const Board& b, SearchRequest sr) {
-    PieceColor side = b.stm();
-    Time moveTime;
-    moveTime = std::max(sr.time[side] / 40 + sr.inc[side], 50ULL);
-    return moveTime;
+void updateSearchLimits() {
+
+    if ( (ss.srlimits & NodesLimit) && ss.nodes >= ss.nodesLimit ) {
+        gStopSearching = true;
+    }
+
+    if ( --ss.timeCheckCountdown <= 0 ) {
+        ss.timeCheckCountdown = TIME_CHECK_INTERVAL;
+        pollSearchSignals();
+        if ( (ss.srlimits & TimeLimit) && !ss.pondering && now_time_ms() - ss.start_time >= ss.timeLimit )
+            gStopSearching = true;
+    }
 }
 
-void start_search(Board& b, ExtMove& result, SearchRequest sr) {
+void start_search(Board& b, ExtMove& result, SearchRequest sr, SearchSignals* signals) {
     ss.start_time = now_time_ms();
+    ss.signals = signals;
+    ss.searchmoves = &sr.searchmoves;
+    ss.multiPV = std::clamp(gMultiPV, 1, MAX_MULTIPV);
+
+    // a go without limits analyses until stop
+    if ( !sr.limits )
+        sr.limits = InfiniteLimit;
+
+    // without a thread reading stop there is no way to end an infinite search, it gets the old 30s instead
+    if ( (sr.limits & InfiniteLimit) && !signals ) {
+        sr.limits = TimeLimit;
+        sr.movetime = 30000;
+        cout << "info string warning time control set to " << sr.movetime << endl;
+    }
 
-    ss.srlimits = sr.limits;
+    ss.infinite = sr.limits & InfiniteLimit;
+    ss.pondering = sr.ponder && signals;
+
+    ss.srlimits = ss.infinite ? sr.limits & ~TimeLimit : sr.limits;
     ss.depthLimit = ( sr.limits & DepthLimit ) ? sr.depth : MAX_DEPTH;
     ss.nodesLimit = ( sr.limits & NodesLimit ) ? sr.nodes : 0;
-    ss.timeLimit = (sr.movetime && (sr.limits & TimeLimit)) ? sr.movetime : getSearchTime(b, sr);
-
-    // TODO: infinite mode not yet suported
-    // if there are no limits or search is set to infinite behave as if we were given 30s per move
-    if ( !(sr.limits) || (sr.limits & InfiniteLimit) ) {
-        ss.timeLimit = 30000;
-        ss.srlimits |= TimeLimit;
-        cout << "info string warning time control set to " << ss.timeLimit << endl;
+
+    if ( ss.srlimits & TimeLimit ) {
+        const TimeBudget budget = compute_time_budget(sr, b.stm());
+        ss.timeLimit = budget.maximum;
+        ss.timeManager.start(budget, sr.movetime != 0);
+        if ( gDebug )
+            cout << "info string time optimum " << budget.optimum << " maximum " << budget.maximum << endl;
     }
 
     gStopSearching = false;
+    ss.timeCheckCountdown = TIME_CHECK_INTERVAL;
 
+    PerfScope perf;
     uint64_t nodeCount = search(b, result, 0);
+    perf.report(nodeCount);
+
+    // an infinite or pondering search that ended by itself waits for stop, or ponderhit, before its bestmove
+    while ( signals && (ss.infinite || ss.pondering) && !signals->stop.load() ) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        pollSearchSignals();
+    }
     
     //auto delta_ms = std::max((now_time_ms() - ss.start_time), 1ULL);
     //cout << "info " << "depth " << depth << " seldepth " << ss.maxPly << " score "; print_score(relativeScore);
     //cout << " time " << delta_ms << " nodes " << nodeCount << " nps " << (nodeCount / delta_ms * 1000) << " pv "; print_pv_moves(b); cout << endl;
 
-    cout << "bestmove "; print_move(result.move); cout << endl;
+    // the second move of the PV is the reply to ponder on
+    const RootMove* best = find_root_move(result.move);
+
+    cout << "bestmove "; print_move(result.move);
+    if ( best && best->pvLength >= 2 ) {
+        cout << " ponder "; print_move(best->pv[1]);
+    }
+    cout << endl;
+
+    ss.searchmoves = nullptr;
 }
 
 SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta);
 SearchResult search_widen(Board& b, int depth, Score val);
 
+/* --
+-- Searches the MultiPV lines of one iteration one after another, each with the root moves of the better
+-- lines excluded, so the lines share the TT and the root ordering of the iteration. The root moves keep
+-- the score and PV of each line, the first moves are the lines once the completed iteration is ordered.
+-- Returns the score of the best line.
+-- */
+static Score search_multipv(Board& b, int depth) {
+    Score best = -CHECKMATE_SCORE;
+
+    ss.excludedCnt = 0;
+    for ( int k = 0; k < ss.multiPV; k++ ) {
+        Score score;
+        Move move;
+
+        // the moves are in the order of the last iteration, the k-th one had the k-th line
+        const Score prevScore = ss.rootMoves[k].prevScore;
+
+        ss.bestMove = NullMove;
+        if ( depth == 1 || prevScore == -CHECKMATE_SCORE )
+            std::tie(score, move) = alphabeta(b, depth, 0, -CHECKMATE_SCORE, CHECKMATE_SCORE);
+        else
+            std::tie(score, move) = search_widen(b, depth, prevScore);
+
+        if ( gStopSearching || ss.bestMove == NullMove )
+            break;
+
+        best = std::max(best, score);
+        ss.excluded[ss.excludedCnt++] = ss.bestMove;
+    }
+    ss.excludedCnt = 0;
+
+    return best;
+}
+
+// Prints the best lines of the iteration, a single one without the multipv field
+static void print_lines(int depth) {
+    const auto delta_ms = std::max<uint64_t>(now_time_ms() - ss.start_time, 1);
+    for ( int k = 0; k < ss.multiPV; k++ ) {
+        const RootMove& rm = ss.rootMoves[k];
+        cout << "info depth " << depth << " seldepth " << ss.maxPly;
+        if ( ss.multiPV > 1 )
+            cout << " multipv " << (k + 1);
+        cout << " score "; print_score(rm.score);
+        cout << " time " << delta_ms << " nodes " << ss.nodes << " nps " << (ss.nodes / delta_ms * 1000) << " pv ";
+        for ( int i = 0; i < rm.pvLength; i++ ) {
+            print_move(rm.pv[i]);
+            cout << " ";
+        }
+        cout << endl;
+    }
+}
+
+// plies a line can reach beyond its nominal depth, the qsearch captures and the PV read from the TT
+constexpr int EXTRA_PLIES = 64;
+
 uint64_t search(Board & b, ExtMove& result, int depth) {
     Score bestValue;
     Move bestMove;
+
+#ifdef TRACK_ALLOCATIONS
+    alloc_stats().clear();
+#endif
+    ALLOC_PHASE(AllocSearch);
+
+    // the tree must not allocate, the stacks grow by at most a line
+    b.reserveStack(ss.depthLimit + EXTRA_PLIES);
     
     ss.depth = ss.depthLimit;
     ss.bestMove = Move();
     ss.nodes = 0;
     ss.qnodes = 0;
     ss.maxPly = 0;
+    pawn_table().probes = 0;
+    pawn_table().hits = 0;
+    material_table().probes = 0;
+    material_table().hits = 0;
+    eval_cache().probes = 0;
+    eval_cache().hits = 0;
+    lazy_eval_stats().clear();
+    ss.iterations.clear();
+    ss.iterations.reserve(MAX_DEPTH + 1);
+
+    // no more lines than root moves, none without a legal move
+    init_root_moves(b);
+    ss.multiPV = std::min(ss.multiPV, ss.rootMoveCnt);
+    ss.excludedCnt = 0;
+#ifdef PHASE_PROFILE
+    phase_profile().clear();
+#endif
+
+    begin_iteration_stats(1);
+    begin_iteration_root_moves();
+    {
+        // the first iteration touches the per thread tables for the first time
+        ALLOC_PHASE(AllocWarmup);
+        if ( ss.multiPV > 1 )
+            bestValue = search_multipv(b, 1);
+        else
+            std::tie(bestValue, bestMove) = alphabeta(b, 1, 0, -CHECKMATE_SCORE, CHECKMATE_SCORE);
+    }
+    end_iteration_root_moves();
+    result.score = bestValue;
+    result.move = ss.bestMove;
+    end_iteration_stats(bestValue);
+
+    const bool timed = ss.srlimits & TimeLimit;
+    if ( timed )
+        ss.timeManager.iteration_done(result.move, result.score, best_move_share(), now_time_ms() - ss.start_time);
 
-    std::tie(bestValue, bestMove) = alphabeta(b, 1, 0, -CHECKMATE_SCORE, CHECKMATE_SCORE);
     for (int depth_iter = 2; depth_iter <= ss.depthLimit; depth_iter++ ) {
-        ss.hashHitCnt = 0;
+        // stop between the iterations if the time is up or the next one wouldn't complete
+        pollSearchSignals();
+        if ( gStopSearching || (timed && !ss.pondering && ss.timeManager.should_stop(now_time_ms() - ss.start_time)) )
+            break;
+
+        begin_iteration_stats(depth_iter);
+        begin_iteration_root_moves();
         
-        std::tie(bestValue, bestMove) = search_widen(b, depth_iter, bestValue);//alphabeta(b, depth_iter, 0, -CHECKMATE_SCORE, CHECKMATE_SCORE);//search_widen(b, depth_iter, bestValue);
+        {
+            ALLOC_PHASE(AllocTree);
+            if ( ss.multiPV > 1 )
+                bestValue = search_multipv(b, depth_iter);
+            else
+                std::tie(bestValue, bestMove) = search_widen(b, depth_iter, bestValue);//alphabeta(b, depth_iter, 0, -CHECKMATE_SCORE, CHECKMATE_SCORE);//search_widen(b, depth_iter, bestValue);
+        }
         
         // don't copy the move from the last iteration if the search was aborted
         if ( !gStopSearching ) {
+            end_iteration_root_moves();
             result.score = bestValue;
             result.move = ss.bestMove;
         } else {
             break;
         }
 
-        auto delta_ms = std::max((now_time_ms() - ss.start_time), 1ULL);
+        end_iteration_stats(bestValue);
+        if ( timed )
+            ss.timeManager.iteration_done(result.move, result.score, best_move_share(), now_time_ms() - ss.start_time);
+
+        if ( ss.silent )
+            continue;
+
+        ALLOC_PHASE(AllocOutput);
 
         //std::cout << "info string depth " << depth_iter << " seldepth " << ss.maxPly << " hash-hits " << ss.hashHitCnt << " nodes " << ss.nodes << " qnodes " << ss.qnodes  << " score " << bestValue << " "; print_pv_moves(b) << std::endl;
         if ( gDebug ) {
-            cout << "info string " << " hash-hits " << ss.hashHitCnt << " nodes " << ss.nodes << " qnodes " << ss.qnodes << endl;
+            cout << "info string " << " hash-hits " << ss.stats.ttCutoffs << " nodes " << ss.nodes << " qnodes " << ss.qnodes
+                 << " pawn-hash-hits " << pawn_table().hits << "/" << pawn_table().probes
+                 << " material-hash-hits " << material_table().hits << "/" << material_table().probes << endl;
         }
-        cout << "info " << "depth " << depth_iter << " seldepth " << ss.maxPly << " score "; print_score(bestValue);
-        cout << " time " << delta_ms << " nodes " << ss.nodes << " nps " << (ss.nodes / delta_ms * 1000) << " pv "; print_pv_moves(b); cout << endl;
+        print_lines(depth_iter);
+    }
+
+    if ( ss.silent )
+        return ss.nodes;
+
+    ALLOC_PHASE(AllocOutput);
+
+#ifdef TRACK_ALLOCATIONS
+    print_alloc_stats(alloc_stats());
+#endif
+
+    if ( gSearchStats )
+        print_search_stats_json(ss.iterations);
+
+    if ( gSearchStats ) {
+        const EvalCache& ec = eval_cache();
+        cout << "info string evalcache hits " << ec.hits << " probes " << ec.probes
+             << " hitrate " << (ec.probes ? ec.hits * 1000 / ec.probes : 0) << " permill" << endl;
+    }
+
+#ifdef PHASE_PROFILE
+    print_phase_profile(phase_profile());
+#endif
+
+    const LazyEvalStats& ls = lazy_eval_stats();
+    if ( gSearchStats ) {
+        cout << "info string lazyeval exits " << ls.exits << " evals " << ls.evals
+             << " rate " << (ls.evals ? ls.exits * 1000 / ls.evals : 0) << " permill" << endl;
     }
+    // the error histogram needs the full evaluation of every lazy exit
+#ifdef LAZY_EVAL_STATS
+    cout << "info string lazyeval margin " << LAZY_EVAL_MARGIN << " wrong " << ls.wrong << " maxerror " << ls.maxError << " errors";
+    for ( int i = 0; i < LazyEvalStats::BUCKET_CNT; i++ )
+        cout << " " << i * LazyEvalStats::BUCKET_WIDTH << (i + 1 < LazyEvalStats::BUCKET_CNT ? ":" : "+:") << ls.errors[i];
+    cout << endl;
+#endif
 
     //ss.bestMove = bestMove;
     //result.score = bestValue;
@@ -129,15 +471,91 @@ uint64_t search(Board & b, ExtMove& result, int depth) {
     return ss.nodes;
 }
 
+uint64_t search_fixed(Board& b, ExtMove& result, int depth, uint64_t nodes) {
+    ss.start_time = now_time_ms();
+
+    ss.srlimits = DepthLimit | (nodes ? NodesLimit : 0);
+    ss.depthLimit = depth ? depth : MAX_DEPTH;
+    ss.nodesLimit = nodes;
+    ss.silent = true;
+    ss.multiPV = 1;
+    ss.searchmoves = nullptr;
+    ss.signals = nullptr;
+    ss.infinite = false;
+    ss.pondering = false;
+
+    gStopSearching = false;
+    ss.timeCheckCountdown = TIME_CHECK_INTERVAL;
+
+    uint64_t nodeCount = search(b, result, 0);
+
+    ss.silent = false;
+    return nodeCount;
+}
+
+// part of total in percent, 0 for an empty total
+static double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+
+static double ratio(uint64_t a, uint64_t b) {
+    return b ? double(a) / b : 0.0;
+}
+
+std::ostream& print_search_stats(const SearchStats& st, uint64_t prevNodes, std::ostream& os) {
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+
+    os << std::fixed << std::setprecision(2)
+       << "info string stats depth " << st.depth << " nodes " << st.nodes << " qnodes " << st.qnodes
+       << " qratio " << ratio(st.qnodes, st.nodes) << " ebf " << ratio(st.nodes, prevNodes)
+       << std::setprecision(1)
+       << " fh1st " << percent(st.firstMoveFailHighs, st.failHighs) << "%"
+       << " cutidx " << std::setprecision(2) << ratio(st.cutoffIndexSum, st.failHighs) << std::setprecision(1)
+       << " tthit " << percent(st.ttHits, st.ttProbes) << "%"
+       << " ttcut " << percent(st.ttCutoffs, st.ttProbes) << "%"
+       << " ttcoll " << percent(st.ttCollisions, st.ttProbes) << "%"
+       << " evalcache " << percent(st.evalCacheHits, st.evalCacheProbes) << "%"
+       << " null " << percent(st.nullCutoffs, st.nullTries) << "%"
+       << " lmrresearch " << percent(st.lmrResearches, st.lmrReductions) << "%"
+       << " aspfail " << st.aspirationFails << "/" << st.aspirationSearches << std::endl;
+
+    os.flags(flags);
+    os.precision(precision);
+    return os;
+}
+
+std::ostream& print_search_stats_json(const std::vector<SearchStats>& iterations, std::ostream& os) {
+    os << "info string stats json {\"iterations\":[";
+    for ( std::size_t i = 0; i < iterations.size(); i++ ) {
+        const SearchStats& st = iterations[i];
+        os << (i ? "," : "") << "{\"depth\":" << st.depth << ",\"score\":" << st.score << ",\"time\":" << st.timeMs
+           << ",\"nodes\":" << st.nodes << ",\"qnodes\":" << st.qnodes
+           << ",\"ebf\":" << ratio(st.nodes, i ? iterations[i - 1].nodes : 0)
+           << ",\"tt\":{\"probes\":" << st.ttProbes << ",\"hits\":" << st.ttHits << ",\"cutoffs\":" << st.ttCutoffs
+           << ",\"collisions\":" << st.ttCollisions << "}"
+           << ",\"evalcache\":{\"probes\":" << st.evalCacheProbes << ",\"hits\":" << st.evalCacheHits << "}"
+           << ",\"failhighs\":{\"total\":" << st.failHighs << ",\"first\":" << st.firstMoveFailHighs
+           << ",\"index_sum\":" << st.cutoffIndexSum << "}"
+           << ",\"null\":{\"tries\":" << st.nullTries << ",\"cutoffs\":" << st.nullCutoffs << "}"
+           << ",\"lmr\":{\"reductions\":" << st.lmrReductions << ",\"researches\":" << st.lmrResearches << "}"
+           << ",\"aspiration\":{\"searches\":" << st.aspirationSearches << ",\"fails\":" << st.aspirationFails << "}}";
+    }
+    os << "]}" << std::endl;
+    return os;
+}
+
 SearchResult search_widen(Board& b, int depth, Score val) {
     Score temp = val,
           alpha = val - 50,
           beta = val + 50;
     
     Move bestMove;  
+    ss.stats.aspirationSearches++;
     std::tie(temp, bestMove) = alphabeta(b, depth, 0, alpha, beta); 
 
     if ( temp <= alpha || temp >= beta ) {
+        ss.stats.aspirationFails++;
         std::tie(temp, bestMove) = alphabeta(b, depth, 0, -CHECKMATE_SCORE, CHECKMATE_SCORE);
     }
 
@@ -153,11 +571,11 @@ SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta) {
     int tried_moves = 0;                // count of moves searched in the current node, used by the late move reduction
     int depth_extensions = 0;           // search depth extensions
     bool needs_fuller_search;           // controls search prunning and reductions, dictates whether the fuller search is required
+    // a MultiPV line or searchmoves, the root is searched without some of its moves and its TT entry isn't saved
+    const bool partialRoot = ply == 0 && (ss.excludedCnt > 0 || (ss.searchmoves && !ss.searchmoves->empty()));
 
     /*-- let the engine process new inputs and update limits during the search --*/
-    if ( ss.nodes & (2048 - 1) ) {
-        updateSearchLimits();
-    }
+    updateSearchLimits();
 
     /*-- check if we should end the search now --*/
     if ( gStopSearching ) {
@@ -176,12 +594,18 @@ SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta) {
     -- if score > beta for beta nodes and alpha if score < alpha for alpha nodes,
     -- always returns the best move to allow further move ordering
     --*/
-    if ( b.ttable()->probe(b.pstate().hash, depth, alpha, beta, score, bestMove) ) {
-        ss.hashHitCnt++;
-        if ( ply == 0 ) {
-            ss.bestMove = bestMove;
+    // the root isn't probed, it is always searched so every root move gets its score and node count,
+    // without the TT move the root is ordered by the root moves of the last iteration instead
+    if ( ply > 0 ) {
+        const Key ttKey = b.ttable()->entry(b.pstate().hash)->hashkey;
+        ss.stats.ttProbes++;
+        ss.stats.ttHits += ttKey == b.pstate().hash;
+        ss.stats.ttCollisions += ttKey && ttKey != b.pstate().hash;
+
+        if ( PROFILED(PhaseTTProbe, b.ttable()->probe(b.pstate().hash, depth, alpha, beta, score, bestMove)) ) {
+            ss.stats.ttCutoffs++;
+            return Pair (score, bestMove);
         }
-        return Pair (score, bestMove);
     }
 
     #endif // DISABLE_TT
@@ -193,7 +617,7 @@ SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta) {
     --*/
     if ( depth == 0 ) {
         ss.nodes++;
-        Score quiet = qsearch(b, ply, alpha, beta);
+        Score quiet = PROFILED(PhaseQsearch, qsearch(b, ply, alpha, beta));
         //!!!(commenting out for now) TODO: slows down search by x3
         // the result and most likely reason is the shortened PV in TT
         //b.ttable()->save(b.pstate().hash, depth, quiet, PV_NODE, bestMove); 
@@ -204,7 +628,7 @@ SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta) {
     /*-- no qsearch extensions, straight evaluation at leaf nodes*/
     if ( depth == 0 ) {
         ss.nodes++;
-        Score value = evaluate(b);
+        Score value = PROFILED(PhaseEval, evaluate(b));
         //b.ttable()->save(b.pstate().hash, depth, value, PV_NODE, bestMove);
         return Pair(value, NullMove);
     }
@@ -226,11 +650,13 @@ SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta) {
         const int R = 2;//(depth > 6) ? 3 : 2; // 2 or 3 for depth > 6
 
         Move refutationMove;
+        ss.stats.nullTries++;
         b.moveDoNull();
         std::tie(score, refutationMove) = alphabeta(b, depth - 1 - R, ply + 1, -beta, -beta + 1);
         score = -score;
         b.moveUndoNull();
         if ( score >= beta ) {
+            ss.stats.nullCutoffs++;
             //b.ttable()->save(b.pstate().hash, depth, score, BETA_NODE, NullMove); // TODO: not sure if tt save should be done here
             return Pair(score, NullMove);
         }
@@ -238,17 +664,28 @@ SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta) {
     #endif // DISABLE_NULL_MOVE_PRUNING
 
     MoveList moves;
-    generate_all_moves(b, moves);
+    if ( ply == 0 ) {
+        /*-- the root moves in the order of the last iteration --*/
+        for ( int i = 0; i < ss.rootMoveCnt; i++ )
+            moves.push_back(ss.rootMoves[i].move);
+    } else {
+        PROFILED(PhaseMovegen, generate_all_moves(b, moves));
+    }
 
     /*-- Handle checkmates and stalemates*/
     if ( moves.empty() )
         return Pair( evaluateNoMoves(b, ply), NullMove );
 
-    sort_moves(b, depth, moves, bestMove);
+    if ( ply > 0 )
+        PROFILED(PhaseSort, sort_moves(b, depth, moves, bestMove));
 
     for ( Move mv : moves ) {
 
+        if ( partialRoot && std::find(ss.excluded, ss.excluded + ss.excludedCnt, mv) != ss.excluded + ss.excludedCnt )
+            continue;
+
         needs_fuller_search = true;
+        const uint64_t subtreeStart = ss.nodes + ss.qnodes;
         ss.nodes++;
 
         //if ( ss.depth == depth ) {
@@ -257,7 +694,12 @@ SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta) {
 
         Move refutationMove;
         
-        b.moveDo(mv);
+        #ifdef USE_COPY_MAKE
+        const Position parent = b;
+        PROFILED(PhaseMoveDo, b.moveDoCopy(mv));
+        #else
+        PROFILED(PhaseMoveDo, b.moveDo(mv));
+        #endif
 
         #ifndef DISABLE_LMR
         /*-- 
@@ -283,6 +725,8 @@ SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta) {
             score = -score;
 
             needs_fuller_search = score > alpha;
+            ss.stats.lmrReductions++;
+            ss.stats.lmrResearches += needs_fuller_search;
         }
         #endif // DISABLE_LMR
 
@@ -306,11 +750,28 @@ SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta) {
             std::tie(score, refutationMove) = alphabeta(b, depth - 1, ply + 1, -beta, -alpha);
             score = -score;
         }
+
+        /*-- the root move keeps its effort, and its score and PV if it raised alpha --*/
+        if ( ply == 0 && !gStopSearching ) {
+            RootMove& rm = *find_root_move(mv);
+            rm.nodes += ss.nodes + ss.qnodes - subtreeStart;
+            rm.score = score > alpha ? score : -CHECKMATE_SCORE;
+            if ( score > alpha )
+                rm.pvLength = 1 + read_pv(b, rm.pv + 1, MAX_PV_LENGTH - 1);
+        }
         
-        b.moveUndo();
+        #ifdef USE_COPY_MAKE
+        PROFILED(PhaseMoveUndo, b.moveUndoCopy(parent));
+        #else
+        PROFILED(PhaseMoveUndo, b.moveUndo());
+        #endif
 
         if ( score >= beta ) {
-            b.ttable()->save(b.pstate().hash, depth, beta, BETA_NODE, mv);
+            ss.stats.failHighs++;
+            ss.stats.firstMoveFailHighs += tried_moves == 0;
+            ss.stats.cutoffIndexSum += tried_moves + 1;
+            if ( !partialRoot )
+                PROFILED(PhaseTTSave, b.ttable()->save(b.pstate().hash, depth, beta, BETA_NODE, mv));
             return Pair(score, bestMove); // ( the betta cutoff )
         }
 
@@ -327,7 +788,8 @@ SearchResult alphabeta(Board& b, int depth, int ply, Score alpha, Score beta) {
     }
 
 
-    b.ttable()->save(b.pstate().hash, depth, alpha, nodeType, bestMove);
+    if ( !partialRoot )
+        PROFILED(PhaseTTSave, b.ttable()->save(b.pstate().hash, depth, alpha, nodeType, bestMove));
     return Pair(alpha, bestMove);
 }
 
@@ -340,7 +802,7 @@ Score qsearch(Board& b, int ply, Score alpha, Score beta) {
     Position& pos = b;
 
     /* get a "stand pat" score */
-    Score val = evaluate(pos);
+    Score val = PROFILED(PhaseEval, evaluate(pos, alpha, beta));
     ss.qnodes++;
     ss.maxPly = std::max(ss.maxPly, ply);
 
@@ -354,9 +816,9 @@ Score qsearch(Board& b, int ply, Score alpha, Score beta) {
     //    return val;
 
     MoveList moveList;
-    generate_all_moves(pos, moveList);
+    PROFILED(PhaseMovegen, generate_all_moves(pos, moveList));
 
-    sort_moves(b, ply - ss.depth, moveList, NullMove);
+    PROFILED(PhaseSort, sort_moves(b, ply - ss.depth, moveList, NullMove));
 
     for ( Move move : moveList ) {
 
@@ -369,9 +831,16 @@ Score qsearch(Board& b, int ply, Score alpha, Score beta) {
             if ( (val + PieceWeight[piece_target] + 200 < alpha) && !IsEndgame(pos) )
                 continue;
 
-            b.moveDo(move);
+            #ifdef USE_COPY_MAKE
+            const Position parent = b;
+            PROFILED(PhaseMoveDo, b.moveDoCopy(move));
+            Value score = -qsearch(b, ply + 1, -beta, -alpha);
+            PROFILED(PhaseMoveUndo, b.moveUndoCopy(parent));
+            #else
+            PROFILED(PhaseMoveDo, b.moveDo(move));
             Value score = -qsearch(b, ply + 1, -beta, -alpha);
-            b.moveUndo();
+            PROFILED(PhaseMoveUndo, b.moveUndo());
+            #endif
             
             if ( score >= beta ) return beta;
             if ( score > alpha ) alpha = score;
@@ -428,4 +897,4 @@ void sort_moves(Board& b, int depth, MoveList& moves, Move bestMove) {
 // bestmove a3b3
 
 // position fen 4Q3/8/8/3K4/1p6/k7/1p6/R7 b - - 0 0
-// go perft 1 -> leads
\ No newline at end of file
+// go perft 1 -> leads
@@ -1,4 +1,8 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
 #include <iostream>
+#include <atomic>
 
 #include "board.h"
 #include "movegen.h"
@@ -48,20 +52,80 @@ using SearchResult = std::pair<Value, Move>;
 -- Endgame detection is based on the amount of material left on the opposite side 
 -- */
 bool inline IsEndgame(const Position& pos) {
-	int32_t materialValue = 0;
-
-	for ( PieceType pt = Pawn; pt < King; pt = PieceType(pt + 1) ) {
-		materialValue += PieceWeight[pt] * (popcount_bb(pos.pieces(!pos.stm(), pt)));
-	}
-	return materialValue <= ENDGAME_MAX_MATERIAL;
+	return pos.material(!pos.stm()) <= ENDGAME_MAX_MATERIAL;
 }
 
-// Search entry point
-void start_search(Board& b, ExtMove& result, SearchRequest sm);
+/* --
+-- Counters of one iteration of the search, the cutoffs, TT, null move and LMR counters only cover
+-- the main search, qsearch nodes are counted in qnodes
+-- */
+struct SearchStats {
+    int      depth = 0;
+    Score    score = 0;
+    uint64_t timeMs = 0;                // since the start of the search
+
+    uint64_t nodes = 0;                 // searched in this iteration
+    uint64_t qnodes = 0;
+
+    uint64_t ttProbes = 0;
+    uint64_t ttHits = 0;                // the entry belongs to the position
+    uint64_t ttCutoffs = 0;             // the entry's score was returned
+    uint64_t ttCollisions = 0;          // the entry is taken by another position
+
+    uint64_t failHighs = 0;             // beta cutoffs of the move loop
+    uint64_t firstMoveFailHighs = 0;
+    uint64_t cutoffIndexSum = 0;        // 1 for a cutoff by the first move
+
+    uint64_t nullTries = 0;
+    uint64_t nullCutoffs = 0;
+
+    uint64_t lmrReductions = 0;
+    uint64_t lmrResearches = 0;         // reduced searches that had to be searched again
+
+    uint64_t aspirationSearches = 0;
+    uint64_t aspirationFails = 0;
+
+    uint64_t evalCacheProbes = 0;       // of the main search and qsearch
+    uint64_t evalCacheHits = 0;
+};
+
+// Print the statistics of every iteration and a JSON dump of them at the end of the search, set by the SearchStats UCI option
+extern bool gSearchStats;
+
+/*-- Statistics of the completed iterations of the last search of the calling thread, by depth from 1 --*/
+const std::vector<SearchStats>& search_stats();
+
+/*-- One info string line of an iteration, prevNodes are the nodes of the previous one for the branching factor --*/
+std::ostream& print_search_stats(const SearchStats& stats, uint64_t prevNodes, std::ostream& os = std::cout);
+std::ostream& print_search_stats_json(const std::vector<SearchStats>& iterations, std::ostream& os = std::cout);
+
+/*-- Most lines of the MultiPV output --*/
+constexpr int MAX_MULTIPV = 64;
+
+// Lines searched and printed by the UCI searches, set by the MultiPV UCI option, the engine's own searches use one
+extern int gMultiPV;
+
+/* --
+-- Requests of the UCI thread to a search running on another thread, polled with the clock.
+-- An infinite or pondering search doesn't print its bestmove before stop, or ponderhit for pondering.
+-- */
+struct SearchSignals {
+    std::atomic<bool> stop{ false };
+    std::atomic<bool> ponderhit{ false };    // the expected move was played, the clock applies from now on
+};
+
+// Search entry point, the signals are optional
+void start_search(Board& b, ExtMove& result, SearchRequest sm, SearchSignals* signals = nullptr);
 
 // Root search 
 uint64_t search(Board& b, ExtMove& result, int depth);
 
+/* --
+-- Searches to a fixed depth and/or number of nodes without the info output, a zero limit is not applied.
+-- The limits and the stop flag are per thread, so independent boards can be searched on several threads at once
+-- */
+uint64_t search_fixed(Board& b, ExtMove& result, int depth, uint64_t nodes);
+
 /* --
 -- Quiecence search
 -- Needed to establish a quiet position (no hanging pieces) befor the board can be evaluated
@@ -78,4 +142,6 @@ SearchResult alphabeta(Board& b, int depth, int ply, int alpha, int beta);
 inline Value evaluateNoMoves(const Position& pos, int ply);
 
 // sort moves
-void sort_moves(Board& b, int depth, MoveList& moves, Move bestMove);
\ No newline at end of file
+void sort_moves(Board& b, int depth, MoveList& moves, Move bestMove);
+
+#endif // SEARCH_H
@@ -0,0 +1,79 @@
+#include "searchthread.h"
+#include "evalcache.h"
+#include "pawns.h"
+#include "material.h"
+
+SearchThread::SearchThread() {
+    thread = std::thread(&SearchThread::loop, this);
+}
+
+SearchThread::~SearchThread() {
+    finish();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+void SearchThread::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while ( true ) {
+        cv.wait(lock, [this]() { return searching || exiting; });
+        if ( exiting )
+            return;
+
+        const bool clear = clearCaches;
+        clearCaches = false;
+        lock.unlock();
+
+        if ( clear ) {
+            eval_cache().clear();
+            pawn_table().clear();
+            material_table().clear();
+        }
+
+        ExtMove result;
+        start_search(*board, result, request, &signals);
+        lock.lock();
+
+        searching = false;
+        cv.notify_all();
+    }
+}
+
+void SearchThread::go(Board& b, const SearchRequest& sr) {
+    finish();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    signals.stop = false;
+    signals.ponderhit = false;
+    board = &b;
+    request = sr;
+    searching = true;
+    cv.notify_all();
+}
+
+void SearchThread::stop() {
+    signals.stop = true;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return !searching; });
+}
+
+void SearchThread::ponderhit() {
+    signals.ponderhit = true;
+}
+
+void SearchThread::clear_caches() {
+    std::lock_guard<std::mutex> lock(mutex);
+    clearCaches = true;
+}
+
+void SearchThread::finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if ( searching && ((request.ponder && !signals.ponderhit) || (request.limits & InfiniteLimit) || !request.limits) )
+        signals.stop = true;
+    cv.wait(lock, [this]() { return !searching; });
+}
@@ -0,0 +1,57 @@
+#ifndef SEARCHTHREAD_H
+#define SEARCHTHREAD_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "board.h"
+#include "engine.h"
+#include "search.h"
+
+/* --
+-- Runs the UCI searches on a thread of its own, so the UCI loop keeps reading stop, ponderhit and isready
+-- while the engine thinks. The thread lives as long as the object, so its per thread tables (pawn, material
+-- and eval caches, accumulators) are kept from one search to the next. The board is only borrowed, the UCI
+-- loop must not touch it before the search finished.
+-- */
+class SearchThread {
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable cv;
+
+    Board*        board = nullptr;
+    SearchRequest request;
+    SearchSignals signals;
+    bool          searching = false;     // a search was handed over and hasn't printed its bestmove yet
+    bool          clearCaches = false;   // the evaluator changed, the caches of the thread are cleared before the next search
+    bool          exiting = false;
+
+    void loop();
+
+public:
+    SearchThread();
+    SearchThread(const SearchThread&) = delete;
+    SearchThread& operator=(const SearchThread&) = delete;
+    ~SearchThread();
+
+    /*-- Starts a search of the board, after the previous one finished --*/
+    void go(Board& b, const SearchRequest& sr);
+
+    /*-- Stops the search and waits for its bestmove --*/
+    void stop();
+
+    /*-- The expected move was played, a pondering search switches to its time limits --*/
+    void ponderhit();
+
+    /*-- Waits for the search, an infinite or pondering one is stopped since it wouldn't end by itself --*/
+    void finish();
+
+    /* --
+    -- The evaluator changed, the evaluation cache, pawn and material tables of the thread hold scores of the
+    -- old one. They are per thread, so the thread clears them itself before its next search.
+    -- */
+    void clear_caches();
+};
+
+#endif // SEARCHTHREAD_H
@@ -2,9 +2,17 @@
 #include <tuple>
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <random>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
 
 #include "board.h"
 #include "search.h"
+#include "evaluate.h"
+#include "searchthread.h"
 
 using namespace std;
 
@@ -13,6 +21,7 @@ using namespace std;
 #define IS_TRUE(x) { if (!(x)) std::cout << __FUNCTION__ << " failed on line " << __LINE__ << std::endl; }
 
 uint64_t perft(Board& b, int depth);
+uint64_t perft_copy(const Position& pos, int depth);
 
 bool test_movegen() {
     
@@ -44,6 +53,22 @@ bool test_movegen() {
         }
     }
 
+    // test the copy-make path
+    for (auto pos : perftTestPositions) {
+        cout << "POSITION: [" << std::get<0>(pos) << "] DEPTH: " << std::get<1>(pos) << " NODES:  " << std::get<2>(pos) << " COPY-MAKE: ";
+
+        b = Board::fromFEN(std::get<0>(pos));
+
+        uint64_t nodes = perft_copy(b, std::get<1>(pos));
+
+        if (nodes == std::get<2>(pos))
+            cout << " PASS " <<  endl;
+        else {
+            cout << "FAIL " << nodes << endl;
+            return false;
+        }
+    }
+
     // test with search
     for ( auto pos : perftTestPositions ) {
         cout << "POSITION: [" << std::get<0>(pos) << "] DEPTH: " << std::get<1>(pos) << " NODES:  " << std::get<2>(pos) << " SEARCH 8: " << endl;
@@ -69,8 +94,421 @@ bool test_movegen() {
     return true;
 }
 
+// Recomputes the incrementally updated state of the position and compares it
+static bool accumulators_match(const Position& pos) {
+    Score material[COLOR_CNT] = { 0, 0 };
+    int phase = 0, psqtMg = 0, psqtEg = 0;
+    Key pawnKey = 0, materialKey = 0;
+
+    for (Square sq = a1; sq < SQUARE_CNT; ++sq) {
+        Piece p = pos.pieceAt(sq);
+        if (p.isEmpty())
+            continue;
+        material[p.color()] += PieceWeight[p.type()];
+        phase  += PhaseWeight[p.type()];
+        psqtMg += PSQT::mg[p.color()][p.type()][sq];
+        psqtEg += PSQT::eg[p.color()][p.type()][sq];
+        if (p.isPawn())
+            pawnKey ^= Zobrist::pieces[p.color()][sq][Pawn];
+        materialKey += materialKeyIncrement(p.color(), p.type());
+    }
+
+    return material[White] == pos.material(White) && material[Black] == pos.material(Black)
+        && phase == pos.phase() && psqtMg == pos.psqtMg() && psqtEg == pos.psqtEg()
+        && Board::hashPosition(pos) == pos.hash() && pawnKey == pos.pawnKey() && materialKey == pos.materialKey();
+}
+
+static bool walk_accumulators(Board& b, int depth) {
+    if (!accumulators_match(b))
+        return false;
+    if (depth == 0)
+        return true;
+
+    MoveList moveList;
+    generate_all_moves(b, moveList);
+    for (Move move : moveList) {
+        b.moveDo(move);
+        bool ok = walk_accumulators(b, depth - 1);
+        b.moveUndo();
+        if (!ok || !accumulators_match(b))
+            return false;
+    }
+    return true;
+}
+
+bool test_accumulators() {
+    vector<string> fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"
+    };
+
+    for (auto fen : fens) {
+        cout << "POSITION: [" << fen << "] ACCUMULATORS: ";
+        Board b = Board::fromFEN(fen);
+        if (walk_accumulators(b, 3)) {
+            cout << " PASS " << endl;
+        } else {
+            cout << "FAIL" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes a network of random weights in the format read by nnue::Network::load
+static bool write_random_network(const string& path, std::uint32_t seed = 20240917) {
+    std::mt19937 rng(seed);
+    auto random = [&rng](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+
+    std::ofstream out(path, std::ios::binary);
+    nnue::FileHeader header = {};
+    std::memcpy(header.magic, "CEBBNNUE", sizeof(header.magic));
+    header.version = nnue::FILE_VERSION;
+    header.inputDims = nnue::INPUT_DIMS;
+    header.halfDims = nnue::HALF_DIMS;
+    header.hiddenDims = nnue::HIDDEN_DIMS;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    auto write = [&out, &random](auto value, std::size_t count, int lo, int hi) {
+        for (std::size_t i = 0; i < count; i++) {
+            value = decltype(value)(random(lo, hi));
+            out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+    };
+    write(std::int16_t(), nnue::HALF_DIMS, 0, 64);
+    write(std::int16_t(), std::size_t(nnue::INPUT_DIMS) * nnue::HALF_DIMS, -8, 8);
+    write(std::int32_t(), nnue::HIDDEN_DIMS, -2000, 2000);
+    write(std::int8_t(), nnue::HIDDEN_DIMS * 2 * nnue::HALF_DIMS, -128, 127);
+    write(std::int32_t(), 1, -100, 100);
+    write(std::int8_t(), nnue::HIDDEN_DIMS, -128, 127);
+    return bool(out);
+}
+
+// Compares the accumulator of the position with one summed up from the weights
+static bool network_matches(const Position& pos) {
+    const nnue::Accumulator& acc = nnue::accumulators().sync(pos);
+
+    for (PieceColor perspective : { White, Black }) {
+        const Square ksq = lsb_bb(pos.pieces(perspective, King));
+        for (int j = 0; j < nnue::HALF_DIMS; j++) {
+            int value = nnue::gNetwork.ftBias[j];
+            for (Square sq = a1; sq < SQUARE_CNT; ++sq) {
+                Piece p = pos.pieceAt(sq);
+                if (!p.isEmpty() && p.type() != King)
+                    value += nnue::gNetwork.ftWeights[nnue::feature_index(perspective, ksq, p.color(), p.type(), sq) * nnue::HALF_DIMS + j];
+            }
+            if (std::int16_t(value) != acc.values[perspective][j])
+                return false;
+        }
+    }
+
+    return nnue::propagate(acc, pos.stm()) == nnue::propagate_scalar(acc, pos.stm());
+}
+
+static bool walk_network(Board& b, int depth) {
+    if (depth == 0)
+        return network_matches(b);
+
+    MoveList moveList;
+    generate_all_moves(b, moveList);
+    for (Move move : moveList) {
+        b.moveDo(move);
+        bool ok = walk_network(b, depth - 1);
+        b.moveUndo();
+        if (!ok)
+            return false;
+    }
+    return network_matches(b);
+}
+
+bool test_nnue() {
+    const string path = (std::filesystem::temp_directory_path() / "chessenginebb_test.nnue").string();
+    bool pass = write_random_network(path) && nnue::gNetwork.load(path);
+
+    vector<pair<string, int>> fens = {
+        { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -", 2 },
+        { "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3 },
+        { "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -", 4 }
+    };
+
+    for (auto fen : fens) {
+        if (!pass)
+            break;
+        cout << "POSITION: [" << fen.first << "] NNUE: ";
+        Board b = Board::fromFEN(fen.first);
+        pass = walk_network(b, fen.second);
+        cout << (pass ? " PASS " : "FAIL") << endl;
+    }
+
+    // the accumulators computed with the first network are refreshed for the second one
+    if (pass) {
+        Board b = Board::fromFEN(fens[0].first);
+        pass = network_matches(b) && write_random_network(path, 20241019) && nnue::gNetwork.load(path) && network_matches(b);
+        cout << "NETWORK SWITCH: " << (pass ? " PASS " : "FAIL") << endl;
+    }
+
+    // setting up a position, as position startpos moves does, doesn't keep the moves of the last one
+    if (pass) {
+        std::size_t stackSize = 0;
+        for (int setup = 0; pass && setup < 3; setup++) {
+            Board b(1);
+            b.setFromFEN(fens[0].first);
+            for (int ply = 0; ply < 8; ply++) {
+                MoveList moveList;
+                generate_all_moves(b, moveList);
+                b.moveDo(moveList[0]);
+            }
+            if (setup == 0)
+                stackSize = nnue::accumulators().size();
+            pass = nnue::accumulators().size() == stackSize;
+        }
+        cout << "ACCUMULATOR STACK: " << stackSize << (pass ? " PASS " : " FAIL") << endl;
+    }
+
+    // the default network or the handcrafted evaluation is used again
+    nnue::gNetwork.unload();
+    std::remove(path.c_str());
+    nnue::gNetwork.load(nnue::DEFAULT_FILE);
+    eval_cache().clear();
+    return pass;
+}
+
+// Packs the positions of the tree, checks that they unpack into the same position and collects them
+static bool walk_packed(Board& b, Board& unpacked, int depth, vector<pair<PackedPosition, string>>& packed) {
+    unpacked.unpack(b.pack());
+    if (unpacked.toFEN() != b.toFEN() || unpacked.hash() != b.hash() || !accumulators_match(unpacked))
+        return false;
+    packed.emplace_back(b.pack(), b.toFEN());
+
+    if (depth == 0)
+        return true;
+
+    MoveList moveList;
+    generate_all_moves(b, moveList);
+    for (Move move : moveList) {
+        b.moveDo(move);
+        bool ok = walk_packed(b, unpacked, depth - 1, packed);
+        b.moveUndo();
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+bool test_packed() {
+    const string path = (std::filesystem::temp_directory_path() / "chessenginebb_test.bin").string();
+    vector<string> fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3"
+    };
+
+    vector<pair<PackedPosition, string>> packed;
+    Board unpacked(1);
+    bool pass = true;
+    for (auto fen : fens) {
+        cout << "POSITION: [" << fen << "] PACKED: ";
+        Board b = Board::fromFEN(fen);
+        pass = walk_packed(b, unpacked, 2, packed);
+        cout << (pass ? " PASS " : "FAIL") << endl;
+        if (!pass)
+            return false;
+    }
+
+    PackedWriter writer;
+    pass = writer.open(path);
+    for (auto& p : packed)
+        writer.write(p.first);
+    writer.close();
+
+    // read back in reverse order to exercise the random access
+    PackedReader reader;
+    pass = pass && reader.open(path) && reader.size() == packed.size();
+    for (std::size_t i = packed.size(); pass && i-- > 0; ) {
+        unpacked.unpack(reader[i]);
+        pass = unpacked.toFEN() == packed[i].second;
+    }
+    cout << "PACKED FILE: " << packed.size() << " positions " << (pass ? " PASS " : "FAIL") << endl;
+
+    reader.close();
+    std::remove(path.c_str());
+    return pass;
+}
+
+// Formats the position, parses it back and checks that nothing was lost
+static bool fen_round_trips(const Position& pos) {
+    char fen[FEN_BUFFER_SIZE], again[FEN_BUFFER_SIZE];
+    const std::size_t length = pos.formatFEN(fen);
+
+    Position parsed;
+    if (!parsed.parseFEN(std::string_view(fen, length)))
+        return false;
+
+    parsed.formatFEN(again);
+    return std::strcmp(fen, again) == 0 && parsed.hash() == pos.hash() && accumulators_match(parsed);
+}
+
+bool test_fen() {
+    std::mt19937 rng(20241019);
+
+    // random games from a few positions
+    vector<string> fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -"
+    };
+
+    vector<string> visited;
+    bool pass = true;
+    Board b(1);
+    for (int game = 0; pass && game < 60; game++) {
+        b.setFromFEN(fens[game % fens.size()]);
+        for (int ply = 0; pass && ply < 120; ply++) {
+            pass = fen_round_trips(b);
+            visited.push_back(b.toFEN());
+
+            MoveList moveList;
+            generate_all_moves(b, moveList);
+            if (moveList.empty())
+                break;
+            b.moveDo(moveList[rng() % moveList.size()]);
+        }
+        while (!b.moves_done.empty())
+            b.moveUndo();
+    }
+    cout << "FEN ROUND TRIP: " << visited.size() << " positions " << (pass ? " PASS " : "FAIL") << endl;
+
+    // invalid records are reported with the field they fail in
+    vector<pair<string, FenError>> invalid = {
+        { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBN w KQkq - 0 1", FenBadPlacement },
+        { "rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", FenBadPlacement },
+        { "rnbqkbnr/pppppppp/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", FenBadPlacement },
+        { "rnbqkbnr/ppppxppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", FenBadPlacement },
+        { "rnbqqbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", FenBadKings },
+        { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNP w KQkq - 0 1", FenBadKings },
+        { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1", FenBadSide },
+        { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkK - 0 1", FenBadCastling },
+        { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e3 0 1", FenBadEnPassant },
+        { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - x 1", FenBadClock },
+        { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 c9", FenTrailing }
+    };
+    for (auto& record : invalid) {
+        Position pos;
+        const FenResult result = pos.parseFEN(record.first);
+        if (result.error != record.second) {
+            cout << "FEN ERROR: [" << record.first << "] " << fen_error_string(result.error) << " FAIL" << endl;
+            pass = false;
+        }
+    }
+
+    // mutated records either fail to parse or round trip
+    const string alphabet = "pnbrqkPNBRQK12345678/ wb-KQkqacdefgh036x";
+    int parsedCnt = 0;
+    for (int i = 0; pass && i < 20000; i++) {
+        string fen = visited[rng() % visited.size()];
+        for (int mutations = 1 + rng() % 3; mutations > 0; mutations--)
+            fen[rng() % fen.size()] = alphabet[rng() % alphabet.size()];
+
+        Position pos;
+        if (pos.parseFEN(fen)) {
+            parsedCnt++;
+            pass = fen_round_trips(pos);
+        }
+    }
+    cout << "FEN FUZZ: " << parsedCnt << " valid mutations " << (pass ? " PASS " : "FAIL") << endl;
+
+    return pass;
+}
+
+// Compares the TT entries of the positions depth plies from the boards, which are at the same position
+static bool tt_entries_match(Board& a, Board& b, int depth) {
+    const TTEntry* ea = a.ttable()->entry(a.hash());
+    const TTEntry* eb = b.ttable()->entry(b.hash());
+    if (ea->hashkey != eb->hashkey || ea->depth != eb->depth || ea->score != eb->score || ea->ttMove != eb->ttMove)
+        return false;
+    if (depth == 0)
+        return true;
+
+    MoveList moveList;
+    generate_all_moves(a, moveList);
+    for (Move move : moveList) {
+        a.moveDo(move);
+        b.moveDo(move);
+        bool ok = tt_entries_match(a, b, depth - 1);
+        a.moveUndo();
+        b.moveUndo();
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+// The search thread clears its caches when the evaluator changes between two searches
+bool test_evaluator_switch() {
+    const string path = (std::filesystem::temp_directory_path() / "chessenginebb_switch.nnue").string();
+    const string fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -";
+    SearchRequest sr;
+    sr.depth = 5;
+    sr.limits = DepthLimit;
+
+    // the first search fills the caches of the thread with handcrafted evaluations
+    nnue::gNetwork.unload();
+    SearchThread searchThread;
+    Board first(1);
+    first.setFromFEN(fen);
+    searchThread.go(first, sr);
+    searchThread.finish();
+
+    const int depth = 3;
+    sr.depth = depth;
+
+    bool pass = write_random_network(path) && nnue::gNetwork.load(path);
+    searchThread.clear_caches();
+    Board second(1);
+    second.setFromFEN(fen);
+    searchThread.go(second, sr);
+    searchThread.finish();
+
+    // the same search on a thread that never saw the handcrafted evaluation
+    Board fresh(1);
+    fresh.setFromFEN(fen);
+    std::thread([&fresh, depth]() { ExtMove result; search_fixed(fresh, result, depth, 0); }).join();
+
+    // an evaluation of the first search left in the caches would change some of the entries
+    pass = pass && second.ttable()->entry(second.hash())->hashkey == second.hash() && tt_entries_match(second, fresh, 2);
+    cout << "EVALUATOR SWITCH: " << (pass ? " PASS " : " FAIL") << endl;
+
+    nnue::gNetwork.unload();
+    std::remove(path.c_str());
+    nnue::gNetwork.load(nnue::DEFAULT_FILE);
+    eval_cache().clear();
+    return pass;
+}
+
+bool test_endgames() {
+    // (fen, largest absolute evaluation) of known draws
+    vector<pair<string, Score>> draws = {
+        { "8/8/8/4k3/8/8/3NNK2/8 w - - 0 1", 10 },
+        { "8/8/8/4k3/8/8/3NNK2/8 b - - 0 1", 10 }
+    };
+
+    bool pass = true;
+    for (auto& draw : draws) {
+        Board b = Board::fromFEN(draw.first);
+        EvalTrace trace;
+        const Score score = evaluate<true>(b, &trace);
+        const bool ok = std::abs(score) <= draw.second;
+        cout << "POSITION: [" << draw.first << "] EVAL: " << score << (ok ? " PASS " : " FAIL") << endl;
+        pass = pass && ok;
+    }
+    return pass;
+}
+
 bool do_tests() {
-    bool pass = test_movegen();
+    bool pass = test_movegen() && test_accumulators() && test_nnue() && test_packed() && test_fen() && test_endgames() && test_evaluator_switch();
     cout << "=======================" << endl;
     if (pass)
         cout << "Tests passed";
@@ -1,3 +1,15 @@
 bool do_tests();
 
 bool test_movegen();
+
+bool test_accumulators();
+
+bool test_nnue();
+
+bool test_packed();
+
+bool test_fen();
+
+bool test_endgames();
+
+bool test_evaluator_switch();
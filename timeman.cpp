@@ -0,0 +1,100 @@
+#include "timeman.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+Time gMoveOverhead = 10;
+
+/*-- Moves the remaining time is spread over when the GUI doesn't send movestogo --*/
+constexpr int MOVE_HORIZON = 40;
+
+/*-- The maximum is at most this many optimums --*/
+constexpr int MAX_OPTIMUM_RATIO = 5;
+
+/*-- Part of the root nodes above which the best move is considered settled --*/
+constexpr double BEST_MOVE_SHARE = 0.9;
+
+TimeBudget compute_time_budget(const SearchRequest& sr, PieceColor side) {
+    TimeBudget budget;
+
+    if ( sr.movetime ) {
+        budget.optimum = budget.maximum = std::max<Time>(sr.movetime > gMoveOverhead ? sr.movetime - gMoveOverhead : 0, 1);
+        return budget;
+    }
+
+    const Time time = sr.time[side];
+    const Time inc = sr.inc[side];
+    const int movesToGo = sr.movestogo > 0 ? std::min(sr.movestogo, MOVE_HORIZON) : MOVE_HORIZON;
+
+    // the clock plus the increments of the following moves, less the overhead of every move
+    Time available = time + inc * (movesToGo - 1);
+    const Time overhead = gMoveOverhead * movesToGo;
+    available = available > overhead ? available - overhead : 0;
+
+    // the maximum borrows from the following moves but leaves a share of the clock,
+    // the last move before the time control may use almost all of it
+    const Time safeTime = time > gMoveOverhead ? time - gMoveOverhead : 0;
+    const double safeShare = 0.5 + 0.4 / movesToGo;
+
+    budget.optimum = available / movesToGo;
+    budget.maximum = std::min<Time>(budget.optimum * MAX_OPTIMUM_RATIO, Time(safeTime * safeShare));
+    budget.maximum = std::max<Time>(budget.maximum, 1);
+    budget.optimum = std::clamp<Time>(budget.optimum, 1, budget.maximum);
+    return budget;
+}
+
+void TimeManager::start(const TimeBudget& budget, bool fixedTime) {
+    *this = TimeManager();
+    this->budget = budget;
+    this->fixedTime = fixedTime;
+}
+
+void TimeManager::iteration_done(Move bestMove, Score score, double bestMoveShare, Time elapsed) {
+    lastIterationTime = iterationTime;
+    iterationTime = elapsed - completedTime;
+    completedTime = elapsed;
+    this->bestMoveShare = bestMoveShare;
+
+    // the first iteration has nothing to be compared to
+    const bool changed = lastBestMove != NullMove && bestMove != lastBestMove;
+    stableIterations = changed ? 0 : stableIterations + 1;
+    instability = instability / 2 + (changed ? 1 : 0);
+
+    scoreDrop = lastBestMove != NullMove ? lastScore - score : 0;
+    lastBestMove = bestMove;
+    lastScore = score;
+}
+
+Time TimeManager::scaled_optimum() const {
+    double scale = 1.0;
+
+    // the best move keeps changing, the decaying count is below 2
+    scale *= 1.0 + 0.5 * instability;
+
+    // the score falls, up to half more time for a drop of a pawn
+    if ( scoreDrop > 0 )
+        scale *= 1.0 + std::min(scoreDrop, 100) / 200.0;
+
+    // the same best move for several iterations and a flat score
+    if ( std::abs(scoreDrop) <= 10 ) {
+        if ( stableIterations >= 6 )
+            scale *= 0.6;
+        else if ( stableIterations >= 3 )
+            scale *= 0.8;
+    }
+
+    // the best move absorbed most of the effort
+    if ( bestMoveShare >= BEST_MOVE_SHARE )
+        scale *= 0.75;
+
+    return std::min<Time>(Time(budget.optimum * scale), budget.maximum);
+}
+
+bool TimeManager::should_stop(Time elapsed) const {
+    // the next iteration takes a few times the last one, it would be stopped before it completes
+    const double growth = lastIterationTime ? std::clamp(double(iterationTime) / lastIterationTime, 1.5, 4.0) : 2.0;
+    if ( elapsed + Time(iterationTime * growth) > budget.maximum )
+        return true;
+
+    return !fixedTime && elapsed >= scaled_optimum();
+}
@@ -0,0 +1,68 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include "types.h"
+#include "engine.h"
+
+/*--------------------
+ -- Time management --
+ -------------------*/
+
+/* --
+-- The time of a move is planned as an optimum, the time the search aims for, and a maximum, where it is
+-- stopped mid-iteration. Between iterations the optimum is scaled by the stability of the search: a best
+-- move that keeps changing or a falling score extend it, a settled best move with a flat score shortens it,
+-- as does a best move that took most of the root nodes, the alternatives were refuted cheaply.
+-- An iteration isn't started if its expected time wouldn't fit into the maximum.
+-- */
+struct TimeBudget {
+    Time optimum = 0;
+    Time maximum = 0;
+};
+
+// Time reserved per move for the communication with the GUI, set by the Move Overhead UCI option
+extern Time gMoveOverhead;
+
+/*-- Budget of the side to move for the time limits of the request --*/
+TimeBudget compute_time_budget(const SearchRequest& sr, PieceColor side);
+
+/* --
+-- Tracks the stability of the iterations and decides whether to start the next one.
+-- Only used for searches with a clock, movetime searches use their whole time.
+-- */
+class TimeManager {
+    TimeBudget budget;
+    bool       fixedTime = false;      // movetime, no scaling
+
+    Move   lastBestMove = NullMove;
+    Score  lastScore = 0;
+    int    stableIterations = 0;       // consecutive iterations with the same best move
+    double instability = 0;            // decaying count of the best move changes
+    Score  scoreDrop = 0;              // of the last iteration, positive if the score fell
+    Time   completedTime = 0;          // when the last iteration completed
+    Time   lastIterationTime = 0;
+    Time   iterationTime = 0;          // of the last completed iteration
+    double bestMoveShare = 0;          // part of the root nodes of the last iteration taken by the best move
+
+public:
+    void start(const TimeBudget& budget, bool fixedTime);
+
+    inline Time maximum() const { return budget.maximum; }
+
+    /*-- Moves the budget later by the given time, for the time spent pondering --*/
+    inline void extend(Time time) {
+        budget.optimum += time;
+        budget.maximum += time;
+    }
+
+    /*-- Records a completed iteration finished at elapsed ms since the start --*/
+    void iteration_done(Move bestMove, Score score, double bestMoveShare, Time elapsed);
+
+    /*-- Optimum time scaled by the stability of the iterations so far --*/
+    Time scaled_optimum() const;
+
+    /*-- Returns true if the search should stop instead of starting another iteration --*/
+    bool should_stop(Time elapsed) const;
+};
+
+#endif // TIMEMAN_H
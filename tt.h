@@ -55,6 +55,11 @@ public:
 		free(table);
 	}
 
+	/*-- Empties the table, the following searches don't see the entries of the previous ones --*/
+	void clear() {
+		memset(table, 0, size * sizeof(TTEntry));
+	}
+
 	/*-- Save information about a node --*/
 	inline void save(Key key, int depth, Score score, NodeType type, Move bestMove) {
 		#ifndef DISABLE_TT
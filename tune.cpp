@@ -0,0 +1,460 @@
+#include "tune.h"
+
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <string_view>
+#include <thread>
+
+#include "board.h"
+#include "search.h"
+#include "util.h"
+
+/*-- Layout of the parameter vector --*/
+enum TuneParamIndex : int {
+    PARAM_PIECE = 0,                                // Pawn..Queen
+    PARAM_MOBILITY = PARAM_PIECE + 5,
+    PARAM_BISHOP_PAIR,
+    PARAM_DOUBLED,
+    PARAM_ISOLATED,
+    PARAM_BACKWARD,
+    PARAM_PASSED,                                   // relative ranks 1..6
+    PARAM_PSQT = PARAM_PASSED + 6,                  // Pawn..King x squares as seen by White
+    PARAM_CNT = PARAM_PSQT + 6 * SQUARE_CNT
+};
+
+/*-- A parameter that isn't tapered uses the middlegame value in both phases --*/
+struct TuneParam {
+    double mg;
+    double eg;
+    bool   tapered;
+};
+
+/*-- Coefficient of a parameter in the evaluation of one position, White's count minus Black's --*/
+struct TuneFeature {
+    std::uint16_t index;
+    std::int16_t  coef;
+};
+
+/*-- Position of the dataset reduced to the coefficients of its evaluation --*/
+struct TuneEntry {
+    std::uint32_t first;        // index of the first feature in the feature pool
+    std::uint8_t  count;
+    std::uint8_t  phase;
+    std::uint8_t  scale;
+    std::uint8_t  result;       // 0 White lost, 1 draw, 2 White won
+};
+
+/*-- Positions of the dataset, all the features are kept in one pool --*/
+struct TuneData {
+    std::vector<TuneEntry>   entries;
+    std::vector<TuneFeature> features;
+    std::uint64_t lines = 0;
+    std::uint64_t skipped = 0;       // no result, not quiet or not evaluated by the handcrafted terms
+    std::uint64_t mismatches = 0;    // the linear model didn't reproduce evaluate()
+
+    void append(const TuneData& other) {
+        const std::uint32_t offset = std::uint32_t(features.size());
+        for (TuneEntry entry : other.entries) {
+            entry.first += offset;
+            entries.push_back(entry);
+        }
+        features.insert(features.end(), other.features.begin(), other.features.end());
+        lines += other.lines;
+        skipped += other.skipped;
+        mismatches += other.mismatches;
+    }
+};
+
+// Runs fn(begin, end, thread) on equal parts of [0, count)
+static void parallel_for(int threads, std::size_t count, const std::function<void(std::size_t, std::size_t, int)>& fn) {
+    std::vector<std::thread> workers;
+    const std::size_t part = (count + threads - 1) / threads;
+    for (int t = 0; t < threads; t++) {
+        const std::size_t begin = std::min(count, t * part);
+        const std::size_t end = std::min(count, begin + part);
+        workers.emplace_back(fn, begin, end, t);
+    }
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+static std::vector<TuneParam> initial_params() {
+    std::vector<TuneParam> params(PARAM_CNT);
+
+    for (int pt = Pawn; pt < King; pt++)
+        params[PARAM_PIECE + pt - Pawn] = { double(PieceWeight[pt]), double(PieceWeight[pt]), false };
+
+    params[PARAM_MOBILITY]    = { double(MobilityWeight), double(MobilityWeight), false };
+    params[PARAM_BISHOP_PAIR] = { double(BishopPairBonus), double(BishopPairBonus), false };
+    params[PARAM_DOUBLED]     = { double(DoubledPenalty[0]), double(DoubledPenalty[1]), true };
+    params[PARAM_ISOLATED]    = { double(IsolatedPenalty[0]), double(IsolatedPenalty[1]), true };
+    params[PARAM_BACKWARD]    = { double(BackwardPenalty[0]), double(BackwardPenalty[1]), true };
+
+    for (int rank = 1; rank <= 6; rank++)
+        params[PARAM_PASSED + rank - 1] = { double(PassedBonus[0][rank]), double(PassedBonus[1][rank]), true };
+
+    for (int pt = Pawn; pt < TYPE_CNT; pt++)
+        for (int sq = 0; sq < SQUARE_CNT; sq++)
+            params[PARAM_PSQT + (pt - Pawn) * SQUARE_CNT + sq] = { double(PSQT::mg[White][pt][sq]), double(PSQT::eg[White][pt][sq]), true };
+
+    return params;
+}
+
+/*-- Game result from White's point of view, 0 loss, 1 draw, 2 win or -1 if the line has none --*/
+static int parse_result(std::string_view line) {
+    if (line.find("1/2-1/2") != line.npos || line.find("[0.5]") != line.npos)
+        return 1;
+    if (line.find("1-0") != line.npos || line.find("[1.0]") != line.npos || line.find("[1]") != line.npos)
+        return 2;
+    if (line.find("0-1") != line.npos || line.find("[0.0]") != line.npos || line.find("[0]") != line.npos)
+        return 0;
+    return -1;
+}
+
+/*-- The FEN part of an EPD line, the four position fields and the move counters if they are present --*/
+static std::string_view parse_fen(std::string_view line) {
+    std::size_t end = 0;
+    for (int field = 0; field < 6; field++) {
+        const std::size_t begin = line.find_first_not_of(' ', end);
+        if (begin == line.npos)
+            break;
+        const std::size_t next = std::min(line.find(' ', begin), line.size());
+        // the move counters are optional and the opcodes start right after the position
+        if (field >= 4 && !std::isdigit(static_cast<unsigned char>(line[begin])))
+            break;
+        end = next;
+    }
+    return line.substr(0, end);
+}
+
+/*-- Adds the coefficients of a quiet position, returns false if the position can't be used --*/
+static bool extract_features(Board& b, const std::vector<TuneParam>& params, TuneData& data, int result) {
+    if (IsKingInCheck(b))
+        return false;
+
+    EvalTrace trace;
+    const Score staticEval = evaluate<true>(b, &trace);
+    if (trace.evaluator != EvalTrace::Handcrafted)
+        return false;
+
+    // only quiet positions, the features of a position with pending captures don't describe its value.
+    // qsearch never returns less than the stand pat, so a null window tells if any capture improves on it
+    if (qsearch(b, 0, staticEval, staticEval + 1) > staticEval)
+        return false;
+
+    TuneEntry entry;
+    entry.first = std::uint32_t(data.features.size());
+    entry.phase = std::uint8_t(std::min(trace.phase, GAME_PHASE_MAX));
+    entry.scale = std::uint8_t(trace.scale);
+    entry.result = std::uint8_t(result);
+
+    auto add = [&data](int index, int coef) {
+        if (coef)
+            data.features.push_back({ std::uint16_t(index), std::int16_t(coef) });
+    };
+
+    for (PieceType pt = Pawn; pt < King; pt = PieceType(pt + 1))
+        add(PARAM_PIECE + pt - Pawn, popcount_bb(b.pieces(White, pt)) - popcount_bb(b.pieces(Black, pt)));
+
+    add(PARAM_MOBILITY, (trace.side[TermMobility][White] - trace.side[TermMobility][Black]) / MobilityWeight);
+    add(PARAM_BISHOP_PAIR, (popcount_bb(b.pieces(White, Bishop)) >= 2) - (popcount_bb(b.pieces(Black, Bishop)) >= 2));
+
+    PawnFeatures pawns[COLOR_CNT];
+    Score mg, eg;
+    PawnTable::evaluate_pawns_side(b, White, mg, eg, &pawns[White]);
+    PawnTable::evaluate_pawns_side(b, Black, mg, eg, &pawns[Black]);
+
+    // penalties are subtracted
+    add(PARAM_DOUBLED, pawns[Black].doubled - pawns[White].doubled);
+    add(PARAM_ISOLATED, pawns[Black].isolated - pawns[White].isolated);
+    add(PARAM_BACKWARD, pawns[Black].backward - pawns[White].backward);
+    for (int rank = 1; rank <= 6; rank++)
+        add(PARAM_PASSED + rank - 1, pawns[White].passed[rank] - pawns[Black].passed[rank]);
+
+    // a black piece uses the white entry of the mirrored square
+    for (PieceType pt = Pawn; pt < TYPE_CNT; pt = PieceType(pt + 1)) {
+        int coef[SQUARE_CNT] = {};
+        Bitboard white = b.pieces(White, pt);
+        Bitboard black = b.pieces(Black, pt);
+        foreach_pop_lsb(sq, white) coef[sq]++;
+        foreach_pop_lsb(sq, black) coef[sq.flip()]--;
+        for (int sq = 0; sq < SQUARE_CNT; sq++)
+            add(PARAM_PSQT + (pt - Pawn) * SQUARE_CNT + sq, coef[sq]);
+    }
+
+    entry.count = std::uint8_t(data.features.size() - entry.first);
+
+    // the model has to reproduce the evaluation, up to the rounding of the separately tapered terms
+    double single = 0, tmg = 0, teg = 0;
+    for (std::size_t i = entry.first; i < data.features.size(); i++) {
+        const TuneParam& p = params[data.features[i].index];
+        (p.tapered ? tmg : single) += p.mg * data.features[i].coef;
+        teg += p.tapered ? p.eg * data.features[i].coef : 0;
+    }
+    const Score model = Score(single) + taperedScore(Score(tmg), Score(teg), entry.phase);
+
+    Score unscaled = 0;
+    for (int term = 0; term < TERM_CNT; term++)
+        unscaled += trace.total[term];
+    if (std::abs(model - unscaled) > 1)
+        data.mismatches++;
+
+    data.entries.push_back(entry);
+    return true;
+}
+
+/*-- Streams the dataset in blocks, the lines of a block are split between the threads --*/
+static TuneData load_dataset(const std::string& path, const std::vector<TuneParam>& params, int threads) {
+    constexpr std::size_t BLOCK_SIZE = 16 << 20;
+
+    TuneData data;
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        cout << "info string error cannot open " << path << endl;
+        return data;
+    }
+
+    // copies share the transposition table of the prototype, qsearch doesn't use it
+    Board prototype(1);
+    std::vector<Board> boards(threads, prototype);
+
+    std::vector<char> buffer;
+    std::string carry;
+
+    while (file) {
+        buffer.assign(carry.begin(), carry.end());
+        buffer.resize(carry.size() + BLOCK_SIZE);
+        file.read(buffer.data() + carry.size(), BLOCK_SIZE);
+        buffer.resize(carry.size() + file.gcount());
+
+        // an incomplete last line waits for the next block
+        std::size_t complete = buffer.size();
+        if (file) {
+            while (complete > 0 && buffer[complete - 1] != '\n')
+                complete--;
+        }
+        carry.assign(buffer.begin() + complete, buffer.end());
+
+        std::vector<std::string_view> lines;
+        std::string_view block(buffer.data(), complete);
+        while (!block.empty()) {
+            const std::size_t eol = std::min(block.find('\n'), block.size());
+            std::string_view line = block.substr(0, eol);
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            if (!line.empty())
+                lines.push_back(line);
+            block.remove_prefix(std::min(eol + 1, block.size()));
+        }
+
+        std::vector<TuneData> parts(threads);
+        parallel_for(threads, lines.size(), [&](std::size_t begin, std::size_t end, int t) {
+            for (std::size_t i = begin; i < end; i++) {
+                parts[t].lines++;
+                const int result = parse_result(lines[i]);
+                Board& b = boards[t];
+                if (result >= 0 && b.setFromFEN(parse_fen(lines[i])) && extract_features(b, params, parts[t], result))
+                    continue;
+                parts[t].skipped++;
+            }
+        });
+
+        for (const TuneData& part : parts)
+            data.append(part);
+    }
+
+    return data;
+}
+
+/*-- Evaluation of an entry by the parameters, from White's point of view --*/
+static inline double linear_eval(const TuneData& data, const TuneEntry& entry, const std::vector<TuneParam>& params) {
+    double single = 0, mg = 0, eg = 0;
+    for (std::uint32_t i = entry.first; i < entry.first + entry.count; i++) {
+        const TuneParam& p = params[data.features[i].index];
+        const double coef = data.features[i].coef;
+        if (p.tapered) {
+            mg += p.mg * coef;
+            eg += p.eg * coef;
+        } else {
+            single += p.mg * coef;
+        }
+    }
+    const double tapered = (mg * entry.phase + eg * (GAME_PHASE_MAX - entry.phase)) / GAME_PHASE_MAX;
+    return (single + tapered) * entry.scale / SCALE_NORMAL;
+}
+
+static inline double sigmoid(double K, double eval) {
+    return 1.0 / (1.0 + std::pow(10.0, -K * eval / 400.0));
+}
+
+/*-- Mean squared error of the predicted results --*/
+static double loss(const TuneData& data, const std::vector<TuneParam>& params, double K, int threads) {
+    std::vector<double> sums(threads, 0.0);
+    parallel_for(threads, data.entries.size(), [&](std::size_t begin, std::size_t end, int t) {
+        double sum = 0;
+        for (std::size_t i = begin; i < end; i++) {
+            const TuneEntry& entry = data.entries[i];
+            const double error = entry.result / 2.0 - sigmoid(K, linear_eval(data, entry, params));
+            sum += error * error;
+        }
+        sums[t] = sum;
+    });
+
+    double total = 0;
+    for (double sum : sums)
+        total += sum;
+    return total / std::max<std::size_t>(data.entries.size(), 1);
+}
+
+/*-- Scaling constant of the sigmoid that fits the current weights best, golden section search --*/
+static double fit_K(const TuneData& data, const std::vector<TuneParam>& params, int threads) {
+    const double ratio = (std::sqrt(5.0) - 1) / 2;
+    double lo = 0.1, hi = 3.0;
+    double a = hi - ratio * (hi - lo), b = lo + ratio * (hi - lo);
+    double la = loss(data, params, a, threads), lb = loss(data, params, b, threads);
+
+    while (hi - lo > 1e-3) {
+        if (la < lb) {
+            hi = b; b = a; lb = la;
+            a = hi - ratio * (hi - lo);
+            la = loss(data, params, a, threads);
+        } else {
+            lo = a; a = b; la = lb;
+            b = lo + ratio * (hi - lo);
+            lb = loss(data, params, b, threads);
+        }
+    }
+    return (lo + hi) / 2;
+}
+
+/*-- Gradient of the loss over all the entries, [0] middlegame and [1] endgame part of each parameter --*/
+static void gradient(const TuneData& data, const std::vector<TuneParam>& params, double K, int threads,
+                     std::vector<std::array<double, 2>>& grad) {
+    std::vector<std::vector<std::array<double, 2>>> parts(threads, std::vector<std::array<double, 2>>(PARAM_CNT, { 0, 0 }));
+
+    parallel_for(threads, data.entries.size(), [&](std::size_t begin, std::size_t end, int t) {
+        std::vector<std::array<double, 2>>& g = parts[t];
+        for (std::size_t i = begin; i < end; i++) {
+            const TuneEntry& entry = data.entries[i];
+            const double s = sigmoid(K, linear_eval(data, entry, params));
+            // d(result - s)^2 / d eval
+            const double d = -2.0 * (entry.result / 2.0 - s) * s * (1 - s) * std::log(10.0) * K / 400.0
+                           * entry.scale / SCALE_NORMAL;
+            const double mgPart = double(entry.phase) / GAME_PHASE_MAX;
+
+            for (std::uint32_t f = entry.first; f < entry.first + entry.count; f++) {
+                const TuneFeature& feature = data.features[f];
+                if (params[feature.index].tapered) {
+                    g[feature.index][0] += d * feature.coef * mgPart;
+                    g[feature.index][1] += d * feature.coef * (1 - mgPart);
+                } else {
+                    g[feature.index][0] += d * feature.coef;
+                }
+            }
+        }
+    });
+
+    const double n = double(std::max<std::size_t>(data.entries.size(), 1));
+    grad.assign(PARAM_CNT, { 0, 0 });
+    for (const auto& part : parts)
+        for (int i = 0; i < PARAM_CNT; i++) {
+            grad[i][0] += part[i][0] / n;
+            grad[i][1] += part[i][1] / n;
+        }
+}
+
+static void print_params(const std::vector<TuneParam>& params) {
+    auto value = [](double v) { return int(std::lround(v)); };
+
+    cout << "PieceWeight = { 0";
+    for (int pt = Pawn; pt < King; pt++)
+        cout << ", " << value(params[PARAM_PIECE + pt - Pawn].mg);
+    cout << ", 0 }" << endl;
+
+    cout << "MobilityWeight = " << value(params[PARAM_MOBILITY].mg) << endl;
+    cout << "BishopPairBonus = " << value(params[PARAM_BISHOP_PAIR].mg) << endl;
+    cout << "DoubledPenalty = { " << value(params[PARAM_DOUBLED].mg) << ", " << value(params[PARAM_DOUBLED].eg) << " }" << endl;
+    cout << "IsolatedPenalty = { " << value(params[PARAM_ISOLATED].mg) << ", " << value(params[PARAM_ISOLATED].eg) << " }" << endl;
+    cout << "BackwardPenalty = { " << value(params[PARAM_BACKWARD].mg) << ", " << value(params[PARAM_BACKWARD].eg) << " }" << endl;
+
+    for (int phase = 0; phase < 2; phase++) {
+        cout << "PassedBonus[" << phase << "] = { 0";
+        for (int rank = 1; rank <= 6; rank++) {
+            const TuneParam& p = params[PARAM_PASSED + rank - 1];
+            cout << ", " << value(phase == 0 ? p.mg : p.eg);
+        }
+        cout << ", 0 }" << endl;
+    }
+
+    // the source tables start at a8
+    const char* names[TYPE_CNT] = { "", "Pawn", "Knight", "Bishop", "Rook", "Queen", "King" };
+    for (int phase = 0; phase < 2; phase++) {
+        for (int pt = Pawn; pt < TYPE_CNT; pt++) {
+            cout << names[pt] << "Table " << (phase == 0 ? "middlegame" : "endgame") << " = {" << endl;
+            for (int rank = RANK_CNT - 1; rank >= 0; rank--) {
+                cout << "   ";
+                for (int file = 0; file < FILE_CNT; file++) {
+                    const TuneParam& p = params[PARAM_PSQT + (pt - Pawn) * SQUARE_CNT + rank * 8 + file];
+                    cout << std::setw(4) << value(phase == 0 ? p.mg : p.eg) << ",";
+                }
+                cout << endl;
+            }
+            cout << "};" << endl;
+        }
+    }
+}
+
+void tune(const std::string& path, int epochs, int threads) {
+    threads = std::max(threads, 1);
+
+    // the tuner works on the handcrafted evaluation
+    const std::string network = nnue::gNetwork.path();
+    nnue::gNetwork.unload();
+
+    std::vector<TuneParam> params = initial_params();
+
+    const std::uint64_t loadStart = now_time_ms();
+    TuneData data = load_dataset(path, params, threads);
+    cout << "info string tune loaded " << data.entries.size() << " quiet positions of " << data.lines << " lines"
+         << " skipped " << data.skipped << " model mismatches " << data.mismatches
+         << " features " << data.features.size() << " time " << (now_time_ms() - loadStart) << "ms" << endl;
+
+    if (!data.entries.empty()) {
+        const double K = fit_K(data, params, threads);
+        cout << "info string tune K " << K << " loss " << loss(data, params, K, threads) << endl;
+
+        // Adam, the step is in centipawns
+        const double rate = 1.0, beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+        std::vector<std::array<double, 2>> grad, m(PARAM_CNT, { 0, 0 }), v(PARAM_CNT, { 0, 0 });
+
+        for (int epoch = 1; epoch <= epochs; epoch++) {
+            const std::uint64_t epochStart = now_time_ms();
+            gradient(data, params, K, threads, grad);
+
+            for (int i = 0; i < PARAM_CNT; i++) {
+                for (int k = 0; k < (params[i].tapered ? 2 : 1); k++) {
+                    m[i][k] = beta1 * m[i][k] + (1 - beta1) * grad[i][k];
+                    v[i][k] = beta2 * v[i][k] + (1 - beta2) * grad[i][k] * grad[i][k];
+                    const double mHat = m[i][k] / (1 - std::pow(beta1, epoch));
+                    const double vHat = v[i][k] / (1 - std::pow(beta2, epoch));
+                    (k == 0 ? params[i].mg : params[i].eg) -= rate * mHat / (std::sqrt(vHat) + epsilon);
+                }
+                if (!params[i].tapered)
+                    params[i].eg = params[i].mg;
+            }
+
+            if (epoch % 10 == 0 || epoch == epochs)
+                cout << "info string tune epoch " << epoch << " loss " << loss(data, params, K, threads)
+                     << " time " << (now_time_ms() - epochStart) << "ms" << endl;
+        }
+
+        print_params(params);
+    }
+
+    if (!network.empty())
+        nnue::gNetwork.load(network);
+}
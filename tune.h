@@ -0,0 +1,20 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <string>
+
+/*------------------
+ -- Texel tuning --
+ -----------------*/
+
+/* --
+-- Tunes the weights of the handcrafted evaluation on an EPD file of positions labeled with game results,
+-- the result is read from a c9 opcode ("1-0", "0-1", "1/2-1/2") or a [1.0], [0.5], [0.0] suffix.
+-- Only quiet positions are used, the ones where qsearch agrees with the static evaluation.
+-- The evaluation of every position is reduced to its coefficients in the parameter vector once,
+-- then each epoch of gradient descent is a dot product over all positions split across the threads.
+-- Prints the tuned weights in the layout of the source tables.
+-- */
+void tune(const std::string& path, int epochs, int threads);
+
+#endif // TUNE_H
@@ -8,6 +8,18 @@
 
 //#define DISABLE_TT
 
+/*-- Search and perft copy the Position instead of using moveDo/moveUndo --*/
+//#define USE_COPY_MAKE
+
+/*-- Lazy evaluation exits also compute the full evaluation to collect their error distribution --*/
+//#define LAZY_EVAL_STATS
+
+/*-- Times the phases of the search (movegen, eval, TT, make/unmake, qsearch) and prints a breakdown, see profile.h --*/
+//#define PHASE_PROFILE
+
+/*-- Counts the heap allocations of the search and aborts on one inside the search tree, see alloctrack.h --*/
+//#define TRACK_ALLOCATIONS
+
 /*-- Debugging on/off --*/
 #define gDebug false
 //#undef assert
@@ -166,35 +178,38 @@ public:
 
 class Piece {
 
-    PieceColor m_color;
-    PieceType  m_type;
+    // | Piece bits meaning:   |
+    // | --------------------- |
+    // | Unused | Color | Type |
+    // |   7-4  |   3   |  2-0 |
+    std::uint8_t code;
 
 public:
 
     Piece() = default;
 
-    constexpr Piece(PieceColor color, PieceType type) : m_color(color), m_type(type) {}
+    constexpr Piece(PieceColor color, PieceType type) : code((color << 3) | type) {}
 
-    constexpr PieceColor color() const { return m_color; }
-    constexpr PieceType type()   const { return m_type; }
+    constexpr PieceColor color() const { return PieceColor(code >> 3); }
+    constexpr PieceType type()   const { return PieceType(code & 0x07); }
 
-    constexpr bool sameColor(const Piece other) const { return m_color == other.m_color; }
-    constexpr bool sameType(const Piece other) const { return m_type == other.m_type; }
+    constexpr bool sameColor(const Piece other) const { return ((code ^ other.code) & 0x08) == 0; }
+    constexpr bool sameType(const Piece other) const { return ((code ^ other.code) & 0x07) == 0; }
 
-    inline void setColor(PieceColor color) { m_color = color; }
-    inline void setType(PieceType type)    { m_type = type; }
+    inline void setColor(PieceColor color) { code = (code & 0x07) | (color << 3); }
+    inline void setType(PieceType type)    { code = (code & 0x08) | type; }
 
 
-    constexpr bool isEmpty()  const { return m_type == Empty; }
-    constexpr bool isPawn()   const { return m_type == Pawn; }
-    constexpr bool isKnight() const { return m_type == Knight; }
-    constexpr bool isBishop() const { return m_type == Bishop; }
-    constexpr bool isRook()   const { return m_type == Rook; }
-    constexpr bool isQueen()  const { return m_type == Queen; }
-    constexpr bool isKing()   const { return m_type == King; }
+    constexpr bool isEmpty()  const { return type() == Empty; }
+    constexpr bool isPawn()   const { return type() == Pawn; }
+    constexpr bool isKnight() const { return type() == Knight; }
+    constexpr bool isBishop() const { return type() == Bishop; }
+    constexpr bool isRook()   const { return type() == Rook; }
+    constexpr bool isQueen()  const { return type() == Queen; }
+    constexpr bool isKing()   const { return type() == King; }
 
-    constexpr bool isWhite() const { return m_color == White; }
-    constexpr bool isBlack() const { return m_color == Black; }
+    constexpr bool isWhite() const { return color() == White; }
+    constexpr bool isBlack() const { return color() == Black; }
 
 }; // !class Piece
 
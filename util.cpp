@@ -1,5 +1,8 @@
 #include "util.h"
 
+#include <iomanip>
+#include <random>
+
 ostream& print_board(const Board& b, ostream& os) {
     os << "+------------------------+\n";
     for ( Square i = a1; i < SQUARE_CNT; ++i ) {
@@ -105,10 +108,75 @@ ostream& print_score(Score score, ostream& os) {
     return os;
 }
 
+static const char* EvalTermNames[TERM_CNT] = { "material", "imbalance", "psqt", "pawns", "mobility" };
+static const char* EvaluatorNames[] = { "handcrafted", "endgame", "network" };
+static const char* PieceTypeNames[TYPE_CNT] = { "empty", "pawn", "knight", "bishop", "rook", "queen", "king" };
+static const char* ColorNames[COLOR_CNT] = { "white", "black" };
+
+ostream& print_eval_trace(const EvalTrace& trace, PieceColor stm, ostream& os) {
+    auto cell = [&os](Score value) -> ostream& { return os << std::setw(10) << value << " |"; };
+
+    os << "Evaluator: " << EvaluatorNames[trace.evaluator] << endl;
+
+    if ( trace.evaluator == EvalTrace::Handcrafted ) {
+        os << "      Term |      White |      Black |      Total |" << endl;
+        os << "-----------+------------+------------+------------+" << endl;
+        for ( int term = 0; term < TERM_CNT; term++ ) {
+            os << std::setw(10) << EvalTermNames[term] << " |";
+            if ( trace.hasSides[term] ) {
+                cell(trace.side[term][White]);
+                cell(trace.side[term][Black]);
+            } else {
+                os << std::setw(10) << "--" << " |" << std::setw(10) << "--" << " |";
+            }
+            cell(trace.total[term]) << endl;
+        }
+        os << "-----------+------------+------------+------------+" << endl;
+        os << "Phase " << trace.phase << "/" << GAME_PHASE_MAX << ", scale " << trace.scale << "/" << SCALE_NORMAL << endl;
+
+        os << "Mobility:" << endl;
+        for ( const EvalTrace::PieceMobility& pm : trace.mobility ) {
+            os << "  " << ColorNames[pm.color] << " " << PieceTypeNames[pm.type] << " at ";
+            print_square(pm.square, os) << " mobility " << pm.mobility << endl;
+        }
+    }
+
+    os << "Evaluation: " << trace.score << "cp (White), "
+       << (stm == White ? trace.score : -trace.score) << "cp (side to move)" << endl;
+    return os;
+}
+
+ostream& print_eval_trace_json(const EvalTrace& trace, PieceColor stm, ostream& os) {
+    os << "{\"evaluator\":\"" << EvaluatorNames[trace.evaluator] << "\"";
+
+    if ( trace.evaluator == EvalTrace::Handcrafted ) {
+        os << ",\"phase\":" << trace.phase << ",\"scale\":" << trace.scale << ",\"terms\":{";
+        for ( int term = 0; term < TERM_CNT; term++ ) {
+            os << (term ? "," : "") << "\"" << EvalTermNames[term] << "\":{";
+            if ( trace.hasSides[term] )
+                os << "\"white\":" << trace.side[term][White] << ",\"black\":" << trace.side[term][Black] << ",";
+            os << "\"total\":" << trace.total[term] << "}";
+        }
+
+        os << "},\"mobility\":[";
+        for ( std::size_t i = 0; i < trace.mobility.size(); i++ ) {
+            const EvalTrace::PieceMobility& pm = trace.mobility[i];
+            os << (i ? "," : "") << "{\"color\":\"" << ColorNames[pm.color] << "\",\"piece\":\"" << PieceTypeNames[pm.type]
+               << "\",\"square\":\"";
+            print_square(pm.square, os) << "\",\"mobility\":" << pm.mobility << "}";
+        }
+        os << "]";
+    }
+
+    os << ",\"score\":" << trace.score << ",\"stm_score\":" << (stm == White ? trace.score : -trace.score) << "}" << endl;
+    return os;
+}
+
 ostream& print_pv_moves(Board& b, ostream& os ) {
-    std::vector<Move> pv = getPrimaryVariation(b);
-    for ( auto mv : pv ) {
-        print_move(mv, os);
+    Move pv[MAX_PV_LENGTH];
+    const int length = read_pv(b, pv);
+    for ( int i = 0; i < length; i++ ) {
+        print_move(pv[i], os);
         os << " ";
     }
 
@@ -136,7 +204,27 @@ Move verify_move(Board& b, std::string moveStr) {
     return retMove;
 }
 
+Move randomMove(Board& b) {
+    thread_local std::mt19937_64 rng(std::random_device{}());
+
+    MoveList moveList;
+    generate_all_moves(b, moveList);
+
+    if ( moveList.empty() )
+        return NullMove;
+
+    return moveList[rng() % moveList.size()];
+}
+
 uint64_t perft(Board& b, int depth) {
+#ifdef USE_COPY_MAKE
+    return perft_copy(b, depth);
+#else
+    return perft_make(b, depth);
+#endif
+}
+
+uint64_t perft_make(Board& b, int depth) {
 
     uint64_t nodes_cnt = 0;
 
@@ -154,7 +242,7 @@ uint64_t perft(Board& b, int depth) {
         for ( Move move : moveList ) {
 
             b.moveDo(move);
-            nodes_cnt += perft(b, depth - 1);
+            nodes_cnt += perft_make(b, depth - 1);
             b.moveUndo();
         }
     }
@@ -162,6 +250,48 @@ uint64_t perft(Board& b, int depth) {
 
 }
 
+uint64_t perft_copy(const Position& pos, int depth) {
+
+    uint64_t nodes_cnt = 0;
+
+    MoveList moveList;
+    Position parent = pos;  // move generation updates the pinned pieces
+
+    if ( depth == 0 ) {
+        return 1;
+    } else if ( depth == 1 ) {
+        generate_all_moves(parent, moveList);
+        return moveList.size();
+    } else {
+
+        generate_all_moves(parent, moveList);
+
+        for ( Move move : moveList ) {
+
+            Position child = parent;
+            child.apply(move);
+            nodes_cnt += perft_copy(child, depth - 1);
+        }
+    }
+    return nodes_cnt;
+}
+
+void perft_compare(Board& b, int depth) {
+    using namespace std::chrono;
+
+    auto start_time = high_resolution_clock::now();
+    uint64_t makeNodes = perft_make(b, depth);
+    auto make_ms = std::max<int64_t>(duration_cast<milliseconds>(high_resolution_clock::now() - start_time).count(), 1);
+
+    start_time = high_resolution_clock::now();
+    uint64_t copyNodes = perft_copy(b, depth);
+    auto copy_ms = std::max<int64_t>(duration_cast<milliseconds>(high_resolution_clock::now() - start_time).count(), 1);
+
+    cout << "make/unmake: " << makeNodes << " nodes " << make_ms << "ms " << (makeNodes / make_ms * 1000) << " nodes/s" << endl;
+    cout << "copy-make:   " << copyNodes << " nodes " << copy_ms << "ms " << (copyNodes / copy_ms * 1000) << " nodes/s" << endl;
+    cout << "sizeof(Position): " << sizeof(Position) << " bytes" << (makeNodes == copyNodes ? "" : "\tNODE COUNT MISMATCH") << endl;
+}
+
 uint64_t divide(Board& b, int depth) {
 
     MoveList moveList;
@@ -184,17 +314,18 @@ uint64_t divide(Board& b, int depth) {
 -- TODO: currently there is no repetition detection, so a pv line can contain a loop repeating moves for a certain position
 -- */
 std::vector<Move> getPrimaryVariation(Board& b) {
-    std::vector<Move> pvmvs;
-
-    //b.moveDo(bestMove);
-    //pvmvs.push_back(bestMove);
+    Move pv[MAX_PV_LENGTH];
+    const int length = read_pv(b, pv);
+    return std::vector<Move>(pv, pv + length);
+}
 
-    int maxPv = 50; // limit max size of the pv line to avoid repetition
+int read_pv(Board& b, Move* pv, int maxLength) {
+    int length = 0;
 
     // make the best known move - the first in pv sequence
     // get the next move from the TT table
     TTEntry* cell = b.ttable()->entry(b.pstate().hash);
-    while ( cell->hashkey == b.pstate().hash && maxPv > 0 ) {
+    while ( cell->hashkey == b.pstate().hash && length < maxLength ) {
         MoveList legalMoves;
         generate_all_moves(b, legalMoves);
 
@@ -208,15 +339,14 @@ std::vector<Move> getPrimaryVariation(Board& b) {
             break;
 
         b.moveDo(cell->ttMove);
-        pvmvs.push_back(cell->ttMove);
+        pv[length++] = cell->ttMove;
         cell = b.ttable()->entry(b.pstate().hash);
-        maxPv--;
     }
 
     // undo moves
-    for ( int i = pvmvs.size() - 1; i >= 0; --i ) {
+    for ( int i = 0; i < length; i++ ) {
         b.moveUndo();
     }
 
-    return pvmvs;
+    return length;
 }
\ No newline at end of file
@@ -15,8 +15,18 @@ using std::ostream;
 using std::cout;
 using std::endl;
 
+// Perft with make/unmake or copy-make, as selected by USE_COPY_MAKE
 uint64_t perft(Board& b, int depth);
 
+// Perft using Board::moveDo/moveUndo
+uint64_t perft_make(Board& b, int depth);
+
+// Perft using copy-make, each child is a copy of its parent with the move applied
+uint64_t perft_copy(const Position& pos, int depth);
+
+// Times perft with make/unmake against copy-make on the same position
+void perft_compare(Board& b, int depth);
+
 uint64_t divide(Board& b, int depth);
 
 ostream& print_board(const Board& b, ostream& os = std::cout);
@@ -33,10 +43,16 @@ ostream& print_move(const Move& move, ostream& os = std::cout);
 // prints the score as cp <score> or mate <mated-in>
 ostream& print_score(Score score, ostream& os = std::cout);
 
+// Prints the terms of an evaluation trace as a table
+ostream& print_eval_trace(const EvalTrace& trace, PieceColor stm, ostream& os = std::cout);
+
+// Prints the terms of an evaluation trace as a single line JSON object
+ostream& print_eval_trace_json(const EvalTrace& trace, PieceColor stm, ostream& os = std::cout);
+
 /* Verifies that the given move in UCI notation is legal and can be played,  returns a legal engine move */
 Move verify_move(Board& b, std::string moveStr);
 
-// Gets a random legal move
+// Gets a random legal move, NullMove if there is none
 Move randomMove(Board& b);
 
 // print the principle variation line
@@ -45,6 +61,12 @@ ostream& print_pv_moves(Board& b, ostream& os = std::cout);
 // Get the primary variation line from TT
 std::vector<Move> getPrimaryVariation(Board& b);
 
+/*-- Longest PV read from the TT, the TT line can loop through repeated positions --*/
+constexpr int MAX_PV_LENGTH = 50;
+
+/*-- Reads the PV from the TT into pv without allocating, returns its length --*/
+int read_pv(Board& b, Move* pv, int maxLength = MAX_PV_LENGTH);
+
 inline bool IsCheckMateScore(Score val) {
 	return std::abs(val) > CHECKMATE_SCORE - 100;
 }